@@ -0,0 +1,303 @@
+#include "AnalysisCache.h"
+
+#include <cstring>
+#include <iostream>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#  define NOMINMAX // Disable macros min() and max()
+#endif
+#include <windows.h>
+#endif
+
+namespace
+{
+    constexpr uint64_t CacheMagic = 0x4C43454361636865; // "LCECache"
+    constexpr uint32_t CacheVersion = 1;
+    constexpr size_t NumProbes = 8; // slots a key can go in, starting at its home slot
+}
+
+struct AnalysisCache::Header
+{
+    uint64_t mMagic;
+    uint32_t mVersion;
+    uint32_t mRecordSize;
+    uint64_t mNumSlots;
+    uint64_t mNumRecords;
+    uint8_t mPadding[32];
+};
+
+bool AnalysisRecord::setMovesAndCaptures(const Stockfish::Move* moves, const size_t numMoves, const CaptureRecord* captures, const size_t numCaptures)
+{
+    const size_t movesSize = numMoves * sizeof(uint16_t);
+    if (movesSize + numCaptures * sizeof(CaptureRecord) > PayloadSize)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < numMoves; ++i)
+    {
+        const uint16_t move = static_cast<uint16_t>(moves[i]);
+        std::memcpy(mPayload + i * sizeof(uint16_t), &move, sizeof(uint16_t));
+    }
+    std::memcpy(mPayload + movesSize, captures, numCaptures * sizeof(CaptureRecord));
+
+    mNumMoves = static_cast<uint8_t>(numMoves);
+    mNumCaptures = static_cast<uint8_t>(numCaptures);
+    return true;
+}
+
+const uint16_t* AnalysisRecord::moves() const
+{
+    return reinterpret_cast<const uint16_t*>(mPayload);
+}
+
+const CaptureRecord* AnalysisRecord::captures() const
+{
+    return reinterpret_cast<const CaptureRecord*>(mPayload + mNumMoves * sizeof(uint16_t));
+}
+
+AnalysisCache::AnalysisCache(const std::string& fileName, const size_t numRecords)
+    : mBaseAddress(nullptr)
+    , mMapping(0)
+    , mMappedSize(0)
+    , mSlotMask(0)
+{
+    size_t numSlots = 1;
+    while (numSlots < numRecords)
+    {
+        numSlots *= 2;
+    }
+
+    if (!_map(fileName, numSlots))
+    {
+        _unmap();
+    }
+}
+
+AnalysisCache::~AnalysisCache()
+{
+    _unmap();
+}
+
+bool AnalysisCache::isOpen() const
+{
+    return mBaseAddress != nullptr;
+}
+
+size_t AnalysisCache::numRecords() const
+{
+    return isOpen() ? static_cast<size_t>(_header()->mNumRecords) : 0;
+}
+
+const AnalysisRecord* AnalysisCache::find(const Stockfish::Key key) const
+{
+    if (!isOpen() || !key)
+    {
+        return nullptr;
+    }
+
+    const AnalysisRecord* slots = _slots();
+    for (size_t i = 0; i < NumProbes; ++i)
+    {
+        const AnalysisRecord& slot = slots[(key + i) & mSlotMask];
+        if (slot.mKey == key)
+        {
+            return &slot;
+        }
+
+        // records are never removed, so the key would have gone in here
+        if (!slot.mKey)
+        {
+            return nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
+void AnalysisCache::store(const AnalysisRecord& record)
+{
+    if (!isOpen() || !record.mKey)
+    {
+        return;
+    }
+
+    AnalysisRecord* slots = _slots();
+    AnalysisRecord* replace = &slots[record.mKey & mSlotMask];
+    for (size_t i = 0; i < NumProbes; ++i)
+    {
+        AnalysisRecord& slot = slots[(record.mKey + i) & mSlotMask];
+        if (slot.mKey == record.mKey)
+        {
+            // a record that is deeper but has fewer principal variations would keep every search that asks for more
+            // of them from ever being found, so only one that is at least as good in both (and better in one) stays
+            const bool slotCoversRecord = slot.mDepth >= record.mDepth && slot.mMultiPV >= record.mMultiPV;
+            const bool sameAnalysis = slot.mDepth == record.mDepth && slot.mMultiPV == record.mMultiPV;
+            if (!slotCoversRecord || sameAnalysis)
+            {
+                slot = record;
+            }
+            return;
+        }
+
+        if (!slot.mKey)
+        {
+            slot = record;
+            ++_header()->mNumRecords;
+            return;
+        }
+
+        if (slot.mDepth < replace->mDepth)
+        {
+            replace = &slot;
+        }
+    }
+
+    *replace = record;
+}
+
+bool AnalysisCache::_map(const std::string& fileName, const size_t numSlots)
+{
+    const size_t newFileSize = sizeof(Header) + numSlots * sizeof(AnalysisRecord);
+
+#ifndef _WIN32
+    const int fd = ::open(fileName.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd == -1)
+    {
+        std::cerr << "Could not open analysis cache " << fileName << std::endl;
+        return false;
+    }
+
+    struct stat statbuf;
+    fstat(fd, &statbuf);
+
+    // a new file is all zeros once it has its size, which is an empty table apart from the header
+    const bool isNewFile = statbuf.st_size == 0;
+    if (isNewFile && ftruncate(fd, newFileSize) == -1)
+    {
+        std::cerr << "Could not resize analysis cache " << fileName << std::endl;
+        ::close(fd);
+        return false;
+    }
+
+    mMappedSize = isNewFile ? newFileSize : static_cast<size_t>(statbuf.st_size);
+    mBaseAddress = mmap(nullptr, mMappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (mBaseAddress == MAP_FAILED)
+    {
+        std::cerr << "Could not mmap() " << fileName << std::endl;
+        mBaseAddress = nullptr;
+        return false;
+    }
+
+#if defined(MADV_RANDOM)
+    madvise(mBaseAddress, mMappedSize, MADV_RANDOM);
+#endif
+#else
+    std::wstring fileNameWide(fileName.begin(), fileName.end());
+    HANDLE fd = CreateFile(fileNameWide.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                           OPEN_ALWAYS, FILE_FLAG_RANDOM_ACCESS, nullptr);
+
+    if (fd == INVALID_HANDLE_VALUE)
+    {
+        std::cerr << "Could not open analysis cache " << fileName << std::endl;
+        return false;
+    }
+
+    DWORD sizeHigh;
+    const DWORD sizeLow = GetFileSize(fd, &sizeHigh);
+    const bool isNewFile = !sizeLow && !sizeHigh;
+    mMappedSize = isNewFile ? newFileSize : (static_cast<size_t>(sizeHigh) << 32) | sizeLow;
+
+    // mapping a new file with a size grows it, zero filled
+    HANDLE mapping = CreateFileMapping(fd, nullptr, PAGE_READWRITE, static_cast<DWORD>(mMappedSize >> 32),
+                                       static_cast<DWORD>(mMappedSize), nullptr);
+    CloseHandle(fd);
+
+    if (!mapping)
+    {
+        std::cerr << "CreateFileMapping() failed for " << fileName << std::endl;
+        return false;
+    }
+
+    mMapping = reinterpret_cast<uint64_t>(mapping);
+    mBaseAddress = MapViewOfFile(mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+
+    if (!mBaseAddress)
+    {
+        std::cerr << "MapViewOfFile() failed, name = " << fileName << ", error = " << GetLastError() << std::endl;
+        return false;
+    }
+#endif
+
+    Header* header = _header();
+    if (isNewFile)
+    {
+        header->mMagic = CacheMagic;
+        header->mVersion = CacheVersion;
+        header->mRecordSize = sizeof(AnalysisRecord);
+        header->mNumSlots = numSlots;
+        header->mNumRecords = 0;
+    }
+
+    const uint64_t numFileSlots = mMappedSize >= sizeof(Header) ? header->mNumSlots : 0;
+    if (mMappedSize < sizeof(Header)
+        || header->mMagic != CacheMagic
+        || header->mVersion != CacheVersion
+        || header->mRecordSize != sizeof(AnalysisRecord)
+        || !numFileSlots
+        || (numFileSlots & (numFileSlots - 1))
+        || mMappedSize != sizeof(Header) + numFileSlots * sizeof(AnalysisRecord))
+    {
+        std::cerr << "Not an analysis cache, or one written by another version: " << fileName << std::endl;
+        return false;
+    }
+
+    // an existing file keeps the size it was made with
+    mSlotMask = static_cast<size_t>(numFileSlots - 1);
+    return true;
+}
+
+void AnalysisCache::_unmap()
+{
+    if (mBaseAddress)
+    {
+#ifndef _WIN32
+        munmap(mBaseAddress, mMappedSize);
+#else
+        UnmapViewOfFile(mBaseAddress);
+#endif
+    }
+
+#ifdef _WIN32
+    if (mMapping)
+    {
+        CloseHandle(reinterpret_cast<HANDLE>(mMapping));
+    }
+#endif
+
+    mBaseAddress = nullptr;
+    mMapping = 0;
+    mMappedSize = 0;
+    mSlotMask = 0;
+}
+
+AnalysisRecord* AnalysisCache::_slots() const
+{
+    return reinterpret_cast<AnalysisRecord*>(static_cast<uint8_t*>(mBaseAddress) + sizeof(Header));
+}
+
+AnalysisCache::Header* AnalysisCache::_header() const
+{
+    static_assert(sizeof(Header) == 64, "the header keeps the records cache line aligned");
+
+    return static_cast<Header*>(mBaseAddress);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include "types.h"
+
+#include <cstdint>
+#include <string>
+
+struct CaptureRecord
+{
+    uint8_t mMoveIndex; // index into the record's moves
+    uint8_t mCapturesHangingPiece;
+    int16_t mExchangeGain;
+};
+
+// everything Board works out for one position, in a fixed size so a file of them can be mapped into memory as one
+// open addressing table
+struct AnalysisRecord
+{
+    static constexpr size_t PayloadSize = 224;
+
+    // the moves of the side to move, in the order the search left them, followed by the captures in the order of
+    // Board::getCaptureTable(). Returns false when they don't fit, such positions aren't cached
+    bool setMovesAndCaptures(const Stockfish::Move* moves, size_t numMoves, const CaptureRecord* captures, size_t numCaptures);
+    const uint16_t* moves() const;
+    const CaptureRecord* captures() const;
+
+    Stockfish::Key mKey = 0; // Position::key() of the position, 0 marks an empty slot
+    uint64_t mPinnedPieces = 0;
+    uint64_t mHangingPieces = 0;
+    int16_t mDepth = 0; // depth the search completed
+    uint8_t mMultiPV = 0;
+    uint8_t mNumMoves = 0;
+    uint8_t mNumCaptures = 0;
+    uint8_t mPadding[3] = {};
+    uint8_t mPayload[PayloadSize] = {};
+};
+
+static_assert(sizeof(AnalysisRecord) == 256, "records are read straight from the file, their size is part of the format");
+
+// Board analysis results kept on disk between runs, keyed by Position::key(). The file is a header followed by a
+// power of two number of record slots and is memory mapped, so looking a position up is a few memory reads and the
+// operating system decides what stays in RAM. Records use the machine's native byte order.
+//
+// Nothing is locked: a cache must only be used by one thread at a time, and a file only by one cache at a time, in
+// this process or any other. find() hands out pointers into the mapping that a store() from elsewhere would change
+// under the reader
+class AnalysisCache
+{
+public:
+    // opens the cache in fileName, creating it with room for numRecords positions (rounded up to a power of 2) if it
+    // doesn't exist. A file that can't be opened or isn't a cache is reported on std::cerr, the cache then stays empty
+    // and drops whatever is stored
+    explicit AnalysisCache(const std::string& fileName, size_t numRecords = 1 << 16);
+    ~AnalysisCache();
+
+    AnalysisCache(const AnalysisCache&) = delete;
+    AnalysisCache& operator=(const AnalysisCache&) = delete;
+
+    bool isOpen() const;
+    size_t numRecords() const;
+
+    // the record of the position with this key, nullptr if it isn't cached
+    const AnalysisRecord* find(Stockfish::Key key) const;
+    // replaces the record of the same position unless that one is at least as deep with at least as many principal
+    // variations, otherwise takes a free slot or, when the slots the key can go in are all taken, the one searched
+    // least deep
+    void store(const AnalysisRecord& record);
+
+private:
+    struct Header;
+
+    bool _map(const std::string& fileName, size_t numSlots);
+    void _unmap();
+    AnalysisRecord* _slots() const;
+    Header* _header() const;
+
+    void* mBaseAddress;
+    uint64_t mMapping;
+    size_t mMappedSize;
+    size_t mSlotMask;
+};
@@ -0,0 +1,80 @@
+#include "AnalysisSession.h"
+
+#include "thread.h"
+
+#include "SearchPool.h"
+
+#include <chrono>
+
+double SessionStatistics::nodeSavingsOver(const SessionStatistics& cold) const
+{
+    if (!cold.mNodes)
+    {
+        return 0.0;
+    }
+
+    return 1.0 - static_cast<double>(mNodes) / static_cast<double>(cold.mNodes);
+}
+
+AnalysisSession::AnalysisSession(const std::string& fenString, const AnalysisLimits& limits, const bool reuseSearch)
+    : mBoard(fenString, false)
+    , mLimits(limits)
+    , mReuseSearch(reuseSearch)
+    , mExpectedLine()
+    , mStatistics()
+{
+    // a session starts like a new game, nothing is left over from whatever searched before it
+    const std::unique_lock<std::mutex> searchLock = SearchPool::lockSearch();
+    SearchPool::start();
+    Stockfish::Threads.main()->wait_for_search_finished();
+    Stockfish::Search::clear();
+}
+
+const Board& AnalysisSession::board() const
+{
+    return mBoard;
+}
+
+MoveSpan AnalysisSession::analyze(const BestMovesCallback& onBestMoves)
+{
+    if (!mReuseSearch)
+    {
+        const std::unique_lock<std::mutex> searchLock = SearchPool::lockSearch();
+        Stockfish::Threads.main()->wait_for_search_finished();
+        Stockfish::Search::clear();
+        mExpectedLine.clear();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    mBoard.mPendingAnalysis.reset();
+    // the pool may already be searching for someone else once _search() returns, so only its result is used
+    Board::SearchResult result = mBoard._search(mLimits, onBestMoves, mExpectedLine);
+    mExpectedLine = std::move(result.mPrincipalVariation);
+
+    ++mStatistics.mNumSearches;
+    mStatistics.mNodes += result.mNodes;
+    mStatistics.mElapsedSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return mBoard.getBestMoves(mLimits.mMultiPV);
+}
+
+void AnalysisSession::applyMove(const Move& move)
+{
+    mBoard.applyMove(move);
+
+    if (!mExpectedLine.empty() && mExpectedLine.front() == move.stockfishMove())
+    {
+        ++mStatistics.mNumExpectedMoves;
+        mExpectedLine.erase(mExpectedLine.begin());
+    }
+    else
+    {
+        mExpectedLine.clear();
+    }
+}
+
+const SessionStatistics& AnalysisSession::statistics() const
+{
+    return mStatistics;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Board.h"
+#include "CommonData.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct SessionStatistics
+{
+    // share of the nodes searched by cold that this session didn't need, negative when it needed more
+    double nodeSavingsOver(const SessionStatistics& cold) const;
+
+    size_t mNumSearches = 0;
+    // moves played that were the first move of the previous search's principal variation, whether or not the search
+    // then made use of it
+    size_t mNumExpectedMoves = 0;
+    uint64_t mNodes = 0;
+    double mElapsedSeconds = 0.0;
+};
+
+// Analyzes the positions of one game in the order they are played. Consecutive positions share most of their search
+// tree, so the transposition table and history tables are kept from one search to the next, the search sees the moves
+// played so far (so it knows about repetitions), and when the move played is the one the last search expected, the
+// rest of its principal variation is searched first.
+//
+// Sessions reset the engine's shared search state when they start, so only one should be in use at a time. Without
+// reuseSearch every search starts from a cleared engine instead, which is what analyzing each position on its own
+// costs and what statistics() of a reusing session can be compared against
+class AnalysisSession
+{
+public:
+    AnalysisSession(const std::string& fenString, const AnalysisLimits& limits, bool reuseSearch = true);
+
+    // the current position, queries on it don't search
+    const Board& board() const;
+
+    // searches the current position, returns board().getBestMoves(limits.mMultiPV)
+    MoveSpan analyze(const BestMovesCallback& onBestMoves = nullptr);
+    // plays a legal move of the side to move
+    void applyMove(const Move& move);
+
+    const SessionStatistics& statistics() const;
+
+private:
+    Board mBoard;
+    AnalysisLimits mLimits;
+    bool mReuseSearch;
+    // principal variation of the last search, with the moves played since taken off the front. Empty once a move
+    // the search didn't expect was played
+    std::vector<Stockfish::Move> mExpectedLine;
+    SessionStatistics mStatistics;
+};
@@ -0,0 +1,366 @@
+#include "Benchmark.h"
+
+#include "search.h"
+#include "thread.h"
+
+#include "Board.h"
+#include "SearchPool.h"
+#include "TacticsScanner.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <stdexcept>
+
+namespace
+{
+    // counted by the operator new below, for every thread, but only while bench runs. The other modes only read the
+    // flag, so their threads don't all write to the same counter
+    std::atomic<bool> countingAllocations(false);
+    std::atomic<uint64_t> numAllocations(0);
+
+    // Stockfish's bench positions, without the ones where the side to move is in check
+    const std::vector<std::string> positions = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 10",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 11",
+        "4rrk1/pp1n3p/3q2pQ/2p1pb2/2PP4/2P3N1/P2B2PP/4RRK1 b - - 7 19",
+        "rq3rk1/ppp2ppp/1bnpb3/3N2B1/3NP3/7P/PPPQ1PP1/2KR3R w - - 7 14",
+        "r1bq1r1k/1pp1n1pp/1p1p4/4p2Q/4Pp2/1BNP4/PPP2PPP/3R1RK1 w - - 2 14",
+        "r3r1k1/2p2ppp/p1p1bn2/8/1q2P3/2NPQN2/PPP3PP/R4RK1 b - - 2 15",
+        "r1bbk1nr/pp3p1p/2n5/1N4p1/2Np1B2/8/PPP2PPP/2KR1B1R w kq - 0 13",
+        "r1bq1rk1/ppp1nppp/4n3/3p3Q/3P4/1BP1B3/PP1N2PP/R4RK1 w - - 1 16",
+        "4r1k1/r1q2ppp/ppp2n2/4P3/5Rb1/1N1BQ3/PPP3PP/R5K1 w - - 1 17",
+        "2rqkb1r/ppp2p2/2npb1p1/1N1Nn2p/2P1PP2/8/PP2B1PP/R1BQK2R b KQ - 0 11",
+        "r1bq1r1k/b1p1npp1/p2p3p/1p6/3PP3/1B2NN2/PP3PPP/R2Q1RK1 w - - 1 16",
+        "3r1rk1/p5pp/bpp1pp2/8/q1PP1P2/b3P3/P2NQRPP/1R2B1K1 b - - 6 22",
+        "r1q2rk1/2p1bppp/2Pp4/p6b/Q1PNp3/4B3/PP1R1PPP/2K4R w - - 2 18",
+        "4k2r/1pb2ppp/1p2p3/1R1p4/3P4/2r1PN2/P4PPP/1R4K1 b - - 3 22",
+        "3q2k1/pb3p1p/4pbp1/2r5/PpN2N2/1P2P2P/5PP1/Q2R2K1 b - - 4 26",
+        "6k1/6p1/6Pp/ppp5/3pn2P/1P3K2/1PP2P2/3N4 b - - 0 1",
+        "3b4/5kp1/1p1p1p1p/pP1PpP1P/P1P1P3/3KN3/8/8 w - - 0 1",
+        "2K5/p7/7P/5pR1/8/5k2/r7/8 w - - 0 1",
+        "8/6pk/1p6/8/PP3p1p/5P2/4KP1q/3Q4 w - - 0 1",
+        "7k/3p2pp/4q3/8/4Q3/5Kp1/P6b/8 w - - 0 1",
+        "8/2p5/8/2kPKp1p/2p4P/2P5/3P4/8 w - - 0 1",
+        "8/1p3pp1/7p/5P1P/2k3P1/8/2K2P2/8 w - - 0 1",
+        "8/pp2r1k1/2p1p3/3pP2p/1P1P1P1P/P5KR/8/8 w - - 0 1",
+        "8/3p4/p1bk3p/Pp6/1Kp1PpPp/2P2P1P/2P5/5B2 b - - 0 1",
+        "5k2/7R/4P2p/5K2/p1r2P1p/8/8/8 b - - 0 1",
+        "6k1/6p1/P6p/r1N5/5p2/7P/1b3PP1/4R1K1 w - - 0 1",
+        "1r3k2/4q3/2Pp3b/3Bp3/2Q2p2/1p1P2P1/1P2KP2/3N4 w - - 0 1",
+        "6k1/4pp1p/3p2p1/P1pPb3/R7/1r2P1PP/3B1P2/6K1 w - - 0 1",
+        "8/3p3B/5p2/5P2/p7/PP5b/k7/6K1 w - - 0 1",
+        "5rk1/q6p/2p3bR/1pPp1rP1/1P1Pp3/P3B1Q1/1K3P2/R7 w - - 93 90",
+        "4rrk1/1p1nq3/p7/2p1P1pp/3P2bp/3Q1Bn1/PPPB4/1K2R1NR w - - 40 21",
+        "r3k2r/3nnpbp/q2pp1p1/p7/Pp1PPPP1/4BNN1/1P5P/R2Q1RK1 w kq - 0 16",
+        "3Qb1k1/1r2ppb1/pN1n2q1/Pp1Pp1Pr/4P2p/4BP2/4B1R1/1R5K b - - 11 40",
+        "4k3/3q1r2/1N2r1b1/3ppN2/2nPP3/1B1R2n1/2R1Q3/3K4 w - - 5 1",
+        "8/8/8/8/5kp1/P7/8/1K1N4 w - - 0 1",
+        "8/8/8/5N2/8/p7/8/2NK3k w - - 0 1",
+        "8/3k4/8/8/8/4B3/4KB2/2B5 w - - 0 1",
+        "8/8/1P6/5pr1/8/4R3/7k/2K5 w - - 0 1",
+        "8/8/3P3k/8/1p6/8/1P6/1K3n2 b - - 0 1",
+        "8/R7/2q5/8/6k1/8/1P5p/K6R w - - 0 124",
+        "6k1/3b3r/1p1p4/p1n2p2/1PPNpP1q/P3Q1p1/1R1RB1P1/5K2 b - - 0 1",
+        "r2r1n2/pp2bk2/2p1p2p/3q4/3PN1QP/2P3R1/P4PP1/5RK1 w - - 0 1",
+        "8/8/8/8/8/6k1/6p1/6K1 w - - 0 1",
+    };
+
+    // Board works things out on first use, so every phase is timed by the queries that first need it
+    enum Phase
+    {
+        Setup,
+        LegalMoves,
+        Pins,
+        Hanging,
+        Captures,
+        Checks,
+        Motifs,
+        Search,
+        PhaseNb
+    };
+
+    constexpr std::array<const char*, PhaseNb> phaseNames = { "setup", "legal_moves", "pins", "hanging", "captures", "checks", "tactics", "search" };
+
+    struct PhaseTotals
+    {
+        double mSeconds = 0.0;
+        uint64_t mAllocations = 0;
+        uint64_t mBoards = 0;
+    };
+
+    template<typename Function>
+    void _measure(PhaseTotals& totals, const Function& function)
+    {
+        const uint64_t allocationsBefore = numAllocations.load(std::memory_order_relaxed);
+        const auto start = std::chrono::steady_clock::now();
+
+        function();
+
+        totals.mSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        totals.mAllocations += numAllocations.load(std::memory_order_relaxed) - allocationsBefore;
+        ++totals.mBoards;
+    }
+
+    // args[index] as a whole number from min to max, fallback when it isn't given. Throws std::invalid_argument when
+    // it is anything else
+    int64_t _parseArgument(const std::vector<std::string>& args, const size_t index, const char* name, const int64_t fallback,
+        const int64_t min, const int64_t max)
+    {
+        if (index >= args.size())
+        {
+            return fallback;
+        }
+
+        size_t numParsed = 0;
+        int64_t value = 0;
+        try
+        {
+            value = std::stoll(args[index], &numParsed);
+        }
+        catch (const std::exception&)
+        {
+            numParsed = 0;
+        }
+
+        if (!numParsed || numParsed != args[index].size() || value < min || value > max)
+        {
+            throw std::invalid_argument(std::string(name) + " has to be a number from " + std::to_string(min) + " to "
+                + std::to_string(max) + ", not " + args[index]);
+        }
+
+        return value;
+    }
+
+    // every answer is folded into a checksum, which keeps the queries from being optimized away and shows whether a
+    // change altered any of them
+    void _hashInto(uint64_t& checksum, const uint64_t value)
+    {
+        checksum = (checksum ^ value) * 0x100000001B3ULL;
+    }
+
+    void _runQueries(const std::string& fenString, TacticsScanner& scanner, std::array<PhaseTotals, PhaseNb>& phases, uint64_t& checksum)
+    {
+        std::optional<Board> board;
+        _measure(phases[Setup], [&]() { board.emplace(fenString, false); });
+
+        _measure(phases[LegalMoves], [&]()
+            {
+                for (Stockfish::Square square = Stockfish::SQ_A1; square <= Stockfish::SQ_H8; ++square)
+                {
+                    _hashInto(checksum, board->numLegalMovesOfPiece(square));
+                }
+            });
+
+        _measure(phases[Pins], [&]()
+            {
+                for (Stockfish::Square square = Stockfish::SQ_A1; square <= Stockfish::SQ_H8; ++square)
+                {
+                    _hashInto(checksum, board->isPiecePinned(square));
+                }
+            });
+
+        _measure(phases[Hanging], [&]()
+            {
+                for (Stockfish::Square square = Stockfish::SQ_A1; square <= Stockfish::SQ_H8; ++square)
+                {
+                    _hashInto(checksum, board->isPieceHanging(square));
+                }
+            });
+
+        _measure(phases[Captures], [&]()
+            {
+                for (const Move& move : board->getAllCaptures())
+                {
+                    _hashInto(checksum, move.stockfishMove());
+                    _hashInto(checksum, board->moveCapturesHangingPiece(move.fromSquare(), move.toSquare()));
+                    _hashInto(checksum, board->isWinningCaptureStaticExchangeEvaluation(move.fromSquare(), move.toSquare()));
+                }
+
+                for (const Capture& capture : board->getCaptureTable())
+                {
+                    _hashInto(checksum, static_cast<uint64_t>(capture.mExchangeGain));
+                }
+
+                for (Stockfish::Square square = Stockfish::SQ_A1; square <= Stockfish::SQ_H8; ++square)
+                {
+                    _hashInto(checksum, board->numCapturesPossibleFromPiece(square));
+                    _hashInto(checksum, board->numLegalMovesForPiecesThePieceCanCapture(square));
+                }
+            });
+
+        _measure(phases[Checks], [&]()
+            {
+                for (const Move& move : board->getAllCheckMoves())
+                {
+                    _hashInto(checksum, move.stockfishMove());
+                }
+            });
+
+        _measure(phases[Motifs], [&]()
+            {
+                const Tactics& tactics = scanner.scan(*board);
+                _hashInto(checksum, tactics.mForks.size());
+                _hashInto(checksum, tactics.mSkewers.size());
+                _hashInto(checksum, tactics.mDiscoveredAttacks.size());
+                _hashInto(checksum, tactics.mOverloadedDefenders.size());
+            });
+    }
+
+    void _printPhases(const std::array<PhaseTotals, PhaseNb>& phases)
+    {
+        std::cerr << "\n==========================="
+                  << "\nPhase           us/board  allocs/board" << std::endl;
+
+        for (int phase = 0; phase < PhaseNb; ++phase)
+        {
+            const PhaseTotals& totals = phases[phase];
+            const double boards = static_cast<double>(std::max<uint64_t>(totals.mBoards, 1));
+
+            std::cerr << std::left << std::setw(14) << phaseNames[phase] << std::right << std::fixed
+                      << std::setw(10) << std::setprecision(3) << totals.mSeconds * 1e6 / boards
+                      << std::setw(14) << std::setprecision(2) << static_cast<double>(totals.mAllocations) / boards << std::endl;
+        }
+    }
+}
+
+// replaces the global allocation functions for the whole binary, only to count how often bench uses them
+void* operator new(const std::size_t size)
+{
+    if (countingAllocations.load(std::memory_order_relaxed))
+    {
+        numAllocations.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    if (void* memory = std::malloc(size ? size : 1))
+    {
+        return memory;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+int Benchmark::Run(const std::vector<std::string>& args)
+{
+    const bool defaultDepth = args.size() < 1;
+    AnalysisLimits limits;
+    int numRepeats = 0;
+    size_t numThreads = 0;
+    try
+    {
+        limits.mDepth = static_cast<int>(_parseArgument(args, 0, "depth", limits.mDepth, 1, Stockfish::MAX_PLY - 1));
+        numRepeats = static_cast<int>(_parseArgument(args, 1, "repeats", 5, 1, 1000000));
+        numThreads = static_cast<size_t>(_parseArgument(args, 2, "threads", 1, 1, 512));
+    }
+    catch (const std::invalid_argument& exception)
+    {
+        std::cerr << exception.what() << "\nusage: bench [depth] [repeats] [threads]" << std::endl;
+        return 1;
+    }
+
+    SearchPoolOptions poolOptions = SearchPool::options();
+    poolOptions.mNumThreads = numThreads;
+    SearchPool::configure(poolOptions);
+    SearchPool::start();
+    Stockfish::Search::clear();
+
+    TacticsScanner scanner;
+    std::array<PhaseTotals, PhaseNb> phases;
+    uint64_t checksum = 0xCBF29CE484222325ULL;
+
+    // the search prints its progress to std::cout, which is kept for the summary
+    std::cout.setstate(std::ios::failbit);
+    countingAllocations.store(true, std::memory_order_relaxed);
+
+    for (int repeat = 0; repeat < numRepeats; ++repeat)
+    {
+        for (const std::string& fenString : positions)
+        {
+            _runQueries(fenString, scanner, phases, checksum);
+        }
+    }
+
+    uint64_t nodesSearched = 0;
+    for (const std::string& fenString : positions)
+    {
+        // with analyzeBoard the search waits for the first getBestMoves(), so only the search is timed here
+        Board board(fenString, defaultDepth);
+        _measure(phases[Search], [&]()
+            {
+                if (!defaultDepth)
+                {
+                    board.analyze(limits);
+                }
+
+                for (const Move& move : board.getBestMoves(limits.mMultiPV))
+                {
+                    _hashInto(checksum, move.stockfishMove());
+                }
+            });
+        nodesSearched += Stockfish::Threads.nodes_searched();
+    }
+
+    countingAllocations.store(false, std::memory_order_relaxed);
+    std::cout.clear();
+
+    double querySeconds = 0.0;
+    uint64_t queryAllocations = 0;
+    for (int phase = 0; phase < Search; ++phase)
+    {
+        querySeconds += phases[phase].mSeconds;
+        queryAllocations += phases[phase].mAllocations;
+    }
+
+    const double numBoards = static_cast<double>(phases[Setup].mBoards);
+    const double boardsPerSecond = querySeconds > 0.0 ? numBoards / querySeconds : 0.0;
+    const double searchSeconds = phases[Search].mSeconds;
+    const double analyzedBoardsPerSecond = searchSeconds > 0.0 ? static_cast<double>(positions.size()) / searchSeconds : 0.0;
+    const double nodesPerSecond = searchSeconds > 0.0 ? static_cast<double>(nodesSearched) / searchSeconds : 0.0;
+
+    _printPhases(phases);
+    std::cerr << "==========================="
+              << "\nBoards/second   : " << static_cast<uint64_t>(boardsPerSecond)
+              << "\nAllocs/board    : " << std::setprecision(2) << static_cast<double>(queryAllocations) / numBoards
+              << "\nAnalyzed/second : " << std::setprecision(3) << analyzedBoardsPerSecond
+              << "\nNodes searched  : " << nodesSearched
+              << "\nNodes/second    : " << static_cast<uint64_t>(nodesPerSecond)
+              << "\nChecksum        : " << std::hex << checksum << std::dec << std::endl;
+
+    std::cout << "{\"positions\": " << positions.size()
+              << ", \"repeats\": " << numRepeats
+              << ", \"depth\": " << limits.mDepth
+              << ", \"threads\": " << numThreads
+              << ", \"phases\": {";
+    for (int phase = 0; phase < PhaseNb; ++phase)
+    {
+        const PhaseTotals& totals = phases[phase];
+        const double boards = static_cast<double>(std::max<uint64_t>(totals.mBoards, 1));
+
+        std::cout << (phase ? ", " : "") << "\"" << phaseNames[phase] << "\": {"
+                  << "\"ns_per_board\": " << std::fixed << std::setprecision(1) << totals.mSeconds * 1e9 / boards
+                  << ", \"allocations_per_board\": " << std::setprecision(2) << static_cast<double>(totals.mAllocations) / boards
+                  << "}";
+    }
+    std::cout << "}, \"boards_per_second\": " << std::setprecision(1) << boardsPerSecond
+              << ", \"allocations_per_board\": " << std::setprecision(2) << static_cast<double>(queryAllocations) / numBoards
+              << ", \"analyzed_boards_per_second\": " << std::setprecision(3) << analyzedBoardsPerSecond
+              << ", \"nodes_searched\": " << nodesSearched
+              << ", \"nodes_per_second\": " << static_cast<uint64_t>(nodesPerSecond)
+              << ", \"checksum\": \"" << std::hex << checksum << std::dec << "\"}" << std::endl;
+    return 0;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// Times Board over a fixed set of positions, like Stockfish's bench does for the search, so the effect of changes to
+// the analysis layer can be measured. Arguments are [depth] [repeats] [threads]: the search depth for analyzed
+// boards (the default analysis depth if not given), how often every position goes through the query phases and the
+// number of search threads. A table is printed to std::cerr and a JSON summary to std::cout
+class Benchmark
+{
+public:
+    // returns the exit code, 1 with a usage message on std::cerr when an argument isn't a number in its range
+    static int Run(const std::vector<std::string>& args);
+};
@@ -1,400 +1,1145 @@
 #include "Board.h"
 
+#include "AnalysisCache.h"
 #include "CommonData.h"
+#include "SearchPool.h"
 
 #include "movegen.h"
 #include "search.h"
 #include "thread.h"
 #include "uci.h"
 
-namespace 
+#include <algorithm>
+#include <stdexcept>
+
+namespace
 {
-    constexpr std::array<Stockfish::Color, 2> colours = { Stockfish::Color::WHITE, Stockfish::Color::BLACK };
+    // the exact value behind Position::see_ge(): the same attackers, x-rays and pins, but with a swap list instead of
+    // a threshold so the result is the material balance itself
+    Stockfish::Value _staticExchangeGain(const Stockfish::Position& position, const Stockfish::Move move)
+    {
+        if (Stockfish::type_of(move) != Stockfish::NORMAL)
+        {
+            return Stockfish::VALUE_ZERO;
+        }
+
+        const Stockfish::Square from = Stockfish::from_sq(move);
+        const Stockfish::Square to = Stockfish::to_sq(move);
+
+        std::array<int, 32> gain;
+        int depth = 0;
+        gain[0] = Stockfish::PieceValue[Stockfish::MG][position.piece_on(to)];
+        int capturerValue = Stockfish::PieceValue[Stockfish::MG][position.piece_on(from)];
+
+        Stockfish::Bitboard occupied = position.pieces() ^ from ^ to;
+        Stockfish::Color stm = Stockfish::color_of(position.piece_on(from));
+        Stockfish::Bitboard attackers = position.attackers_to(to, occupied);
+
+        while (true)
+        {
+            stm = ~stm;
+            attackers &= occupied;
+
+            Stockfish::Bitboard stmAttackers = attackers & position.pieces(stm);
+            if (position.pinners(~stm) & occupied)
+            {
+                stmAttackers &= ~position.blockers_for_king(stm);
+            }
+
+            if (!stmAttackers)
+            {
+                break;
+            }
+
+            // the least valuable attacker recaptures, uncovering any x-ray attackers behind it
+            Stockfish::PieceType recapturer = Stockfish::PAWN;
+            while (!(stmAttackers & position.pieces(recapturer)))
+            {
+                ++recapturer;
+            }
+
+            // the king can only recapture a piece that isn't defended anymore
+            if (recapturer == Stockfish::KING && (attackers & ~position.pieces(stm)))
+            {
+                break;
+            }
+
+            ++depth;
+            gain[depth] = capturerValue - gain[depth - 1];
+            capturerValue = Stockfish::PieceValue[Stockfish::MG][recapturer];
+
+            occupied ^= Stockfish::least_significant_square_bb(stmAttackers & position.pieces(recapturer));
+            if (recapturer == Stockfish::PAWN || recapturer == Stockfish::BISHOP || recapturer == Stockfish::QUEEN)
+            {
+                attackers |= Stockfish::attacks_bb<Stockfish::BISHOP>(to, occupied) & position.pieces(Stockfish::BISHOP, Stockfish::QUEEN);
+            }
+            if (recapturer == Stockfish::ROOK || recapturer == Stockfish::QUEEN)
+            {
+                attackers |= Stockfish::attacks_bb<Stockfish::ROOK>(to, occupied) & position.pieces(Stockfish::ROOK, Stockfish::QUEEN);
+            }
+        }
+
+        // either side can stop capturing whenever carrying on would lose more
+        for (; depth > 0; --depth)
+        {
+            gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+        }
+
+        return Stockfish::Value(gain[0]);
+    }
+
+    // en passant captures a pawn that isn't on the square moved to
+    Stockfish::Square _victimSquare(const Stockfish::Position& position, const Stockfish::Move capture)
+    {
+        return Stockfish::type_of(capture) == Stockfish::EN_PASSANT
+            ? Stockfish::to_sq(capture) - Stockfish::pawn_push(position.side_to_move())
+            : Stockfish::to_sq(capture);
+    }
+
+    // the legal moves colour would have if it were its turn, for the side that isn't to move. Stockfish only generates
+    // for the side to move, so these come straight from attack bitboards instead of a null move, leaving the position
+    // untouched. Like after a null move there is no en passant, that right belongs to the side to move
+    Stockfish::ExtMove* _generateWaitingSideMoves(const Stockfish::Position& position, const Stockfish::Color colour, Stockfish::ExtMove* moveList)
+    {
+        assert(colour != position.side_to_move());
+
+        const Stockfish::Color opponent = ~colour;
+        const Stockfish::Square kingSquare = position.square<Stockfish::KING>(colour);
+        const Stockfish::Bitboard occupied = position.pieces();
+        const Stockfish::Bitboard checkers = position.attackers_to(kingSquare) & position.pieces(opponent);
+        const Stockfish::Bitboard pinnedPieces = position.blockers_for_king(colour) & position.pieces(colour);
+
+        // where pieces other than the king may go. A king in check here only comes from a FEN that can't happen in a
+        // game, it is still answered the way the rules say: block or capture a single checker. The same goes for the
+        // opponent's king being in check, taking it isn't a move
+        Stockfish::Bitboard allowedTargets = ~position.pieces(colour) & ~position.pieces(opponent, Stockfish::KING);
+        if (checkers)
+        {
+            allowedTargets &= Stockfish::more_than_one(checkers) ? 0 : Stockfish::between_bb(kingSquare, Stockfish::lsb(checkers));
+        }
+
+        const auto addMoves = [&](const Stockfish::Square from, Stockfish::Bitboard targets)
+        {
+            targets &= allowedTargets;
+            if (pinnedPieces & from)
+            {
+                targets &= Stockfish::line_bb(kingSquare, from);
+            }
+
+            while (targets)
+            {
+                const Stockfish::Square to = Stockfish::pop_lsb(targets);
+                if (Stockfish::type_of(position.piece_on(from)) == Stockfish::PAWN && Stockfish::relative_rank(colour, to) == Stockfish::RANK_8)
+                {
+                    for (const Stockfish::PieceType promotion : { Stockfish::QUEEN, Stockfish::ROOK, Stockfish::BISHOP, Stockfish::KNIGHT })
+                    {
+                        *moveList++ = Stockfish::make<Stockfish::PROMOTION>(from, to, promotion);
+                    }
+                }
+                else
+                {
+                    *moveList++ = Stockfish::make_move(from, to);
+                }
+            }
+        };
+
+        Stockfish::Bitboard pawns = position.pieces(colour, Stockfish::PAWN);
+        while (pawns)
+        {
+            const Stockfish::Square from = Stockfish::pop_lsb(pawns);
+            const Stockfish::Square push = from + Stockfish::pawn_push(colour);
+
+            Stockfish::Bitboard targets = Stockfish::pawn_attacks_bb(colour, from) & position.pieces(opponent);
+            if (!(occupied & push))
+            {
+                targets |= push;
+
+                const Stockfish::Square doublePush = push + Stockfish::pawn_push(colour);
+                if (Stockfish::relative_rank(colour, from) == Stockfish::RANK_2 && !(occupied & doublePush))
+                {
+                    targets |= doublePush;
+                }
+            }
+
+            addMoves(from, targets);
+        }
+
+        Stockfish::Bitboard pieces = position.pieces(colour) ^ position.pieces(colour, Stockfish::PAWN, Stockfish::KING);
+        while (pieces)
+        {
+            const Stockfish::Square from = Stockfish::pop_lsb(pieces);
+            addMoves(from, Stockfish::attacks_bb(Stockfish::type_of(position.piece_on(from)), from, occupied));
+        }
+
+        // the king must not move to an attacked square, including ones only shielded by the king itself
+        Stockfish::Bitboard kingTargets = Stockfish::attacks_bb<Stockfish::KING>(kingSquare) & ~position.pieces(colour);
+        while (kingTargets)
+        {
+            const Stockfish::Square to = Stockfish::pop_lsb(kingTargets);
+            if (!(position.attackers_to(to, occupied ^ kingSquare) & position.pieces(opponent)))
+            {
+                *moveList++ = Stockfish::make_move(kingSquare, to);
+            }
+        }
+
+        if (checkers)
+        {
+            return moveList;
+        }
+
+        // castling follows Position::legal(): no square the king passes may be attacked, and in Chess960 the rook may
+        // not be what blocks a check
+        for (const Stockfish::CastlingRights castling : { colour & Stockfish::KING_SIDE, colour & Stockfish::QUEEN_SIDE })
+        {
+            if (!position.can_castle(castling) || position.castling_impeded(castling))
+            {
+                continue;
+            }
+
+            const Stockfish::Square rookSquare = position.castling_rook_square(castling);
+            const Stockfish::Square kingTo = Stockfish::relative_square(colour, rookSquare > kingSquare ? Stockfish::SQ_G1 : Stockfish::SQ_C1);
+            const Stockfish::Direction step = kingTo > kingSquare ? Stockfish::WEST : Stockfish::EAST;
+
+            bool pathAttacked = false;
+            for (Stockfish::Square square = kingTo; square != kingSquare; square += step)
+            {
+                pathAttacked |= bool(position.attackers_to(square) & position.pieces(opponent));
+            }
+
+            if (!pathAttacked && (!position.is_chess960() || !(position.blockers_for_king(colour) & rookSquare)))
+            {
+                *moveList++ = Stockfish::make<Stockfish::CASTLING>(kingSquare, rookSquare);
+            }
+        }
+
+        return moveList;
+    }
 }
 
 Board::Board(const std::string& fenString, const bool analyzeBoard)
-    : mBoard()
+    : mMoveStates()
+    , mAppliedMoves()
+    , mHasLegalMoves()
+    , mHasHangingPieces()
+    , mHasCaptureTable(false)
+    , mHasCheckMoves(false)
+    , mHasCaptureMoves(false)
+    , mMoveOffsets()
+    , mNumMovesFromSquare()
+    , mNumLegalMoves()
+    , mLegalMoveTargets()
+    , mHangingPieces(0)
+    , mNumCheckMoves(0)
+    , mNumCaptureMoves(0)
+    , mCaptures()
+    , mCaptureTargets()
+    , mFirstCapture()
+    , mSeeRows(0)
+    , mIsShared(false)
+    , mPendingAnalysis()
     , mOrderedMoves()
+    , mAsyncAnalysis()
 {
-    mStateList = std::make_unique<std::deque<Stockfish::StateInfo>>(std::deque<Stockfish::StateInfo>(1));
-    mRawBoard.set(fenString, false, &mStateList->back(), Stockfish::Threads.main());
+    // no thread, the search sets up its own copy of the position for every thread it runs
+    mRawBoard.set(fenString, false, &mRootState, nullptr);
 
-    _initializePieces();
-    _generateLegalMoves();
+    _resetDerivedFacts();
     if (analyzeBoard)
     {
-        _analyzeBoard();
+        mPendingAnalysis = AnalysisLimits();
     }
-    _initializePinnedPieces();
-    _initializeHangingPieces();
 }
 
-size_t Board::numLegalMovesOfPiece(const Stockfish::Square square) const 
+Board::Board(const std::string& fenString, const AnalysisLimits& limits, const BestMovesCallback& onBestMoves)
+    : Board(fenString, false)
 {
-    if (const std::optional<Piece>& piece = mBoard[_squareToIndex(square)])
+    analyze(limits, onBestMoves);
+}
+
+Board::Board(const std::string& fenString, const AnalysisLimits& limits, AnalysisCache& cache)
+    : Board(fenString, false)
+{
+    // only a depth limit says how deep a record has to be, searches limited by nodes or time alone always search
+    const AnalysisRecord* record = limits.mDepth ? cache.find(mRawBoard.key()) : nullptr;
+    if (record && record->mDepth >= limits.mDepth && record->mMultiPV >= limits.mMultiPV && _readAnalysis(*record))
+    {
+        return;
+    }
+
+    // the depth comes from the search itself, the main thread's may already belong to the next search
+    int depth = 0;
+    analyze(limits, [&depth](MoveSpan, const int completedDepth) { depth = completedDepth; });
+
+    // without legal moves the search doesn't complete any depth, but there is nothing deeper to find either
+    if (_sideToMoveBegin() == _sideToMoveEnd())
+    {
+        depth = std::max(depth, limits.mDepth);
+    }
+
+    AnalysisRecord newRecord;
+    if (_writeAnalysis(newRecord, depth, limits.mMultiPV))
     {
-        return piece->getLegalMoves().size();
+        cache.store(newRecord);
     }
+}
 
-    return 0;
+Board::~Board()
+{
+    _waitForAsyncAnalysis();
+}
+
+size_t Board::numLegalMovesOfPiece(const Stockfish::Square square) const 
+{
+    return _movesEnd(square) - _movesBegin(square);
 }
 
 size_t Board::numCapturesPossibleFromPiece(const Stockfish::Square square) const
 {
-    size_t captures = 0;
-    if (const std::optional<Piece>& piece = mBoard[_squareToIndex(square)])
-    {
-        const std::vector<Move>& moves = piece->getLegalMoves();
-        for (const Move& move : moves)
+    return std::count_if(_movesBegin(square), _movesEnd(square), [this](const Move move)
         {
-            if (mRawBoard.capture(move.mStockfishMove))
-            {
-                ++captures;
-            }
-        }
-    }
-
-    return captures;
+            return mRawBoard.capture(move.stockfishMove());
+        });
 }
 
 bool Board::isPiecePinned(const Stockfish::Square square) const 
 {
-    if (const std::optional<Piece>& piece = mBoard[_squareToIndex(square)])
-    {
-        return piece->isPinned();
-    }
+    // the position keeps the pinned pieces of both kings up to date itself
+    const Stockfish::Piece piece = mRawBoard.piece_on(square);
 
-    return false;
+    return piece != Stockfish::NO_PIECE && (mRawBoard.blockers_for_king(Stockfish::color_of(piece)) & square);
 }
 
 bool Board::isPieceHanging(const Stockfish::Square square) const
 {
-    if (const std::optional<Piece>& piece = mBoard[_squareToIndex(square)])
+    const Stockfish::Piece piece = mRawBoard.piece_on(square);
+    if (piece == Stockfish::NO_PIECE)
     {
-        return piece->isHanging();
+        return false;
     }
 
-    return false;
+    _requireHangingPieces(Stockfish::color_of(piece));
+
+    return mHangingPieces & Stockfish::square_bb(square);
 }
 
 size_t Board::numLegalMovesForPiecesThePieceCanCapture(const Stockfish::Square capturingPieceSquare) const
 {
     size_t numLegalMoves = 0;
-    if (const std::optional<Piece>& capturingPiece = mBoard[_squareToIndex(capturingPieceSquare)])
+    for (const Move* move = _movesBegin(capturingPieceSquare); move != _movesEnd(capturingPieceSquare); ++move)
     {
-        const std::vector<Move>& capturingPieceMoves = capturingPiece->getLegalMoves();
-        for (const Move& move : capturingPieceMoves)
-        {
-            if (const std::optional<Piece>& capturedPiece = mBoard[_squareToIndex(move.mToSquare)])
-            {
-                numLegalMoves += capturedPiece->getLegalMoves().size();
-            }
-        }
+        numLegalMoves += numLegalMovesOfPiece(move->toSquare());
     }
 
     return numLegalMoves;
 }
 
-std::vector<Move> Board::getBestMoves(size_t numMoves) const
+MoveSpan Board::getBestMoves(size_t numMoves) const
 {
+    _waitForAsyncAnalysis();
+    if (mPendingAnalysis)
+    {
+        const AnalysisLimits limits = *mPendingAnalysis;
+        mPendingAnalysis.reset();
+        _search(limits, nullptr);
+    }
+
     numMoves = std::min(numMoves, mOrderedMoves.size());
-    std::vector bestMoves(mOrderedMoves.begin(), mOrderedMoves.begin() + numMoves);
 
-    return bestMoves;
+    return MoveSpan(mOrderedMoves.data(), mOrderedMoves.data() + numMoves);
 }
 
-std::vector<Move> Board::getAllCheckMoves() const
+MoveSpan Board::getAllCheckMoves() const
 {
-    std::vector<Move> checkMoves;
-    const std::vector<Move> possibleMoves = _allPossibleMoves();
+    if (!mHasCheckMoves)
+    {
+        mNumCheckMoves = _filterSideToMoveMoves(mCheckMoves, [this](const Move move)
+            {
+                return mRawBoard.gives_check(move.stockfishMove());
+            });
+        mHasCheckMoves = true;
+    }
+
+    return MoveSpan(mCheckMoves.data(), mCheckMoves.data() + mNumCheckMoves);
+}
 
-    for (const Move& move : possibleMoves)
+MoveSpan Board::getAllCaptures() const
+{
+    if (!mHasCaptureMoves)
     {
-        if (mRawBoard.gives_check(move.mStockfishMove))
-        {
-            checkMoves.emplace_back(move);
-        }
+        mNumCaptureMoves = _filterSideToMoveMoves(mCaptureMoves, [this](const Move move)
+            {
+                return mRawBoard.capture(move.stockfishMove());
+            });
+        mHasCaptureMoves = true;
+    }
+
+    return MoveSpan(mCaptureMoves.data(), mCaptureMoves.data() + mNumCaptureMoves);
+}
+
+MoveSpan Board::getLegalMoves() const
+{
+    return MoveSpan(_sideToMoveBegin(), _sideToMoveEnd());
+}
+
+MoveSpan Board::getLegalMovesOfPiece(const Stockfish::Square square) const
+{
+    return MoveSpan(_movesBegin(square), _movesEnd(square));
+}
+
+bool Board::moveCapturesHangingPiece(const Stockfish::Square from, const Stockfish::Square to) const
+{
+    const Capture* capture = findCapture(from, to);
+
+    return capture && capture->mCapturesHangingPiece;
+}
+
+void Board::applyMove(const Move& move)
+{
+    _waitForAsyncAnalysis();
+    assert(mRawBoard.pseudo_legal(move.stockfishMove()) && mRawBoard.legal(move.stockfishMove()));
+
+    mMoveStates.emplace_back();
+    mRawBoard.do_move(move.stockfishMove(), mMoveStates.back());
+    mAppliedMoves.push_back(move.stockfishMove());
+
+    _resetDerivedFacts();
+}
+
+void Board::undoMove()
+{
+    _waitForAsyncAnalysis();
+    assert(!mAppliedMoves.empty());
+    if (mAppliedMoves.empty())
+    {
+        return;
     }
 
-    return checkMoves;
+    mRawBoard.undo_move(mAppliedMoves.back());
+    mAppliedMoves.pop_back();
+    mMoveStates.pop_back();
+
+    _resetDerivedFacts();
 }
 
-std::vector<Move> Board::getAllCaptures() const
+bool Board::isWinningCaptureStaticExchangeEvaluation(const Stockfish::Square from, const Stockfish::Square to) const
 {
-    std::vector<Move> captureMoves;
-    const std::vector<Move> possibleMoves = _allPossibleMoves();
+    if (const Capture* capture = findCapture(from, to))
+    {
+        return capture->isWinningExchange();
+    }
 
-    const Stockfish::Color currentPlayer = mRawBoard.side_to_move();
+    if (mIsShared)
+    {
+        return mRawBoard.see_ge(Stockfish::make_move(from, to));
+    }
+
+    const int row = _squareToIndex(from);
+    if (!(mSeeRows & from))
+    {
+        mSeeRows |= from;
+        mSeeKnown[row] = 0;
+        mSeeWinning[row] = 0;
+    }
 
-    for (const Move& move : possibleMoves)
+    if (!(mSeeKnown[row] & to))
     {
-        if (const std::optional<Piece>& capturedPiece = mBoard[_squareToIndex(move.mToSquare)])
+        mSeeKnown[row] |= to;
+        if (mRawBoard.see_ge(Stockfish::make_move(from, to)))
         {
-            assert(capturedPiece->colour() == ~currentPlayer);
-            captureMoves.emplace_back(move);
+            mSeeWinning[row] |= to;
         }
     }
 
-    return captureMoves;
+    return mSeeWinning[row] & to;
 }
 
-bool Board::moveCapturesHangingPiece(const Stockfish::Square from, const Stockfish::Square to) const
+const std::vector<Capture>& Board::getCaptureTable() const
 {
-    const std::optional<Piece>& pieceAttacking = mBoard[_squareToIndex(from)];
-    const std::optional<Piece>& pieceAttacked = mBoard[_squareToIndex(to)];
-    if (!pieceAttacking || !pieceAttacked)
+    if (!mHasCaptureTable)
     {
-        return false;
+        _buildCaptureTable();
+        mHasCaptureTable = true;
     }
 
-    if (pieceAttacking->colour() != mRawBoard.side_to_move() || !pieceAttacking->canMoveToSquare(to))
+    return mCaptures;
+}
+
+const Capture* Board::findCapture(const Stockfish::Square from, const Stockfish::Square to) const
+{
+    const std::vector<Capture>& captures = getCaptureTable();
+    const int fromIndex = _squareToIndex(from);
+    if (!(mCaptureTargets[fromIndex] & to))
     {
-        return false;
+        return nullptr;
     }
 
-    return pieceAttacked->isHanging();
+    const Stockfish::Bitboard targetsBefore = mCaptureTargets[fromIndex] & (Stockfish::square_bb(to) - 1);
+    return &captures[mFirstCapture[fromIndex] + Stockfish::popcount(targetsBefore)];
 }
 
-bool Board::isWinningCaptureStaticExchangeEvaluation(const Stockfish::Square from, const Stockfish::Square to) const
+std::string Board::fen() const
 {
-    const Stockfish::Move move = Stockfish::make_move(from, to);
+    return mRawBoard.fen();
+}
 
-    return mRawBoard.see_ge(move);
+Stockfish::Key Board::key() const
+{
+    return mRawBoard.key();
 }
 
-void Board::_analyzeBoard()
+Stockfish::Key Board::keyOf(const std::string& fenString)
 {
-    // the search is hard coded to find principal variation of 5 moves. This could be a variable, and a new search initiated each time
-    // we want more "best moves" than all previous times. For simplicity, I just left it as 5 so it's not so slow. 
-    Stockfish::Search::LimitsType limits;
-    limits.depth = 12; // depth 12 so it's quick to iterate
-    limits.nodes = std::numeric_limits<uint64_t>::max();
+    return Stockfish::Position::key_of(fenString);
+}
 
-    Stockfish::Threads.start_thinking(mRawBoard, mStateList, limits, false);
-    Stockfish::Threads.main()->wait_for_search_finished();
-    const std::vector<Stockfish::Search::RootMove>& moves = Stockfish::Threads.main()->rootMoves;
+size_t Board::numLegalMoves() const
+{
+    return _sideToMoveEnd() - _sideToMoveBegin();
+}
 
-    for (const Stockfish::Search::RootMove& rootMove : moves)
-    {
-        assert(!rootMove.pv.empty());
-        if (!rootMove.pv.empty())
+std::optional<Move> Board::findSanMove(const std::string& san) const
+{
+    std::string text = san.substr(0, san.find_first_of("+#!?"));
+    text.erase(std::remove_if(text.begin(), text.end(), [](const char c) { return c == 'x' || c == ':' || c == '='; }), text.end());
+
+    const bool isCastling = text == "O-O" || text == "0-0" || text == "O-O-O" || text == "0-0-0";
+    const bool isQueenSideCastling = text.size() == 5;
+
+    // what's left is [piece][from file][from rank]<to square>[promotion], long algebraic "e2-e4" included
+    const auto pieceTypeOf = [](const char c)
         {
-            mOrderedMoves.emplace_back(rootMove.pv[0]);
-        }
+            const size_t index = std::string("PNBRQK").find(c);
+            return index == std::string::npos ? Stockfish::NO_PIECE_TYPE : Stockfish::PieceType(index + 1);
+        };
+
+    Stockfish::PieceType promotion = Stockfish::NO_PIECE_TYPE;
+    if (!isCastling && text.size() > 2 && pieceTypeOf(text.back()) != Stockfish::NO_PIECE_TYPE)
+    {
+        promotion = pieceTypeOf(text.back());
+        text.pop_back();
     }
-}
 
-void Board::_initializePieces()
-{
-    for (const Stockfish::Color colour : colours)
+    Stockfish::PieceType pieceType = Stockfish::PAWN;
+    if (!isCastling && !text.empty() && pieceTypeOf(text.front()) != Stockfish::NO_PIECE_TYPE)
     {
-        Stockfish::Bitboard pieces = mRawBoard.pieces(colour);
-        while (pieces)
+        pieceType = pieceTypeOf(text.front());
+        text.erase(0, 1);
+    }
+    text.erase(std::remove(text.begin(), text.end(), '-'), text.end());
+
+    if (!isCastling && (text.size() < 2 || text.size() > 4))
+    {
+        return std::nullopt;
+    }
+
+    const auto isFile = [](const char c) { return c >= 'a' && c <= 'h'; };
+    const auto isRank = [](const char c) { return c >= '1' && c <= '8'; };
+
+    Stockfish::Square to = Stockfish::SQ_NONE;
+    int fromFile = -1;
+    int fromRank = -1;
+    if (!isCastling)
+    {
+        const char toFile = text[text.size() - 2];
+        const char toRank = text[text.size() - 1];
+        if (!isFile(toFile) || !isRank(toRank))
         {
-            const Stockfish::Square square = Stockfish::pop_lsb(pieces);
-            const Stockfish::PieceType pieceType = Stockfish::type_of(mRawBoard.piece_on(square));
-            mBoard[_squareToIndex(square)] = Piece(colour, pieceType);
+            return std::nullopt;
+        }
+        to = Stockfish::make_square(Stockfish::File(toFile - 'a'), Stockfish::Rank(toRank - '1'));
+
+        for (size_t i = 0; i + 2 < text.size(); ++i)
+        {
+            if (isFile(text[i]))
+            {
+                fromFile = text[i] - 'a';
+            }
+            else if (isRank(text[i]))
+            {
+                fromRank = text[i] - '1';
+            }
+            else
+            {
+                return std::nullopt;
+            }
         }
     }
-}
 
-void Board::_initializePinnedPieces()
-{
-    for (const Stockfish::Color colour : colours)
+    std::optional<Move> match;
+    for (const Move* move = _sideToMoveBegin(); move != _sideToMoveEnd(); ++move)
     {
-        Stockfish::Bitboard pinnedPieces = mRawBoard.blockers_for_king(colour) & mRawBoard.pieces(colour);
-        while (pinnedPieces)
-        {
-            const Stockfish::Square square = Stockfish::pop_lsb(pinnedPieces);
+        const Stockfish::Square from = move->fromSquare();
+        const Stockfish::MoveType moveType = move->typeOfMove();
 
-            std::optional<Piece>& piece = mBoard[_squareToIndex(square)];
-            assert(piece);
+        bool matches;
+        if (isCastling)
+        {
+            // castling moves are encoded as the king taking its own rook
+            matches = moveType == Stockfish::CASTLING && isQueenSideCastling == (move->toSquare() < from);
+        }
+        else
+        {
+            const Stockfish::PieceType movePromotion = moveType == Stockfish::PROMOTION ? move->promotionType() : Stockfish::NO_PIECE_TYPE;
+            matches = moveType != Stockfish::CASTLING
+                && Stockfish::type_of(mRawBoard.piece_on(from)) == pieceType
+                && move->toSquare() == to
+                && (fromFile < 0 || Stockfish::file_of(from) == fromFile)
+                && (fromRank < 0 || Stockfish::rank_of(from) == fromRank)
+                && movePromotion == (promotion == Stockfish::NO_PIECE_TYPE && moveType == Stockfish::PROMOTION ? Stockfish::QUEEN : promotion);
+        }
 
-            if (piece)
+        if (matches)
+        {
+            if (match)
             {
-                piece->setIsPinned();
+                return std::nullopt;
             }
+            match = *move;
         }
     }
+
+    return match;
 }
 
-void Board::_initializeHangingPieces()
+void Board::analyze(const AnalysisLimits& limits, const BestMovesCallback& onBestMoves)
 {
-    for (const Stockfish::Color attackingColour : colours)
-    {
-        const Stockfish::Color defendingColour = ~attackingColour;
-        Stockfish::Bitboard pieces = mRawBoard.pieces();
+    _waitForAsyncAnalysis();
+    mPendingAnalysis.reset();
+    _search(limits, onBestMoves);
+}
 
-        while (pieces)
+std::shared_future<std::vector<Move>> Board::analyzeAsync(const AnalysisLimits& limits, const BestMovesCallback& onAnalyzed)
+{
+    _waitForAsyncAnalysis();
+    mPendingAnalysis.reset();
+
+    const std::shared_ptr<std::promise<std::vector<Move>>> bestMoves = std::make_shared<std::promise<std::vector<Move>>>();
+    mAsyncAnalysis = bestMoves->get_future().share();
+
+    // the job can't use getBestMoves(), which waits for the job
+    SearchPool::post([this, limits, onAnalyzed, bestMoves]()
         {
-            const Stockfish::Square square = Stockfish::pop_lsb(pieces);
-            if (attackingColour == Stockfish::color_of(mRawBoard.piece_on(square)))
+            try
             {
-                continue;
-            }
+                int depth = 0;
+                _search(limits, [&depth](MoveSpan, const int completedDepth) { depth = completedDepth; });
 
-            const Stockfish::Bitboard piecesAttackingSquare = mRawBoard.attackers_to(square);
-            Stockfish::Bitboard attackingPieces = piecesAttackingSquare & mRawBoard.pieces(attackingColour);
-            // en passsant special case is not handled by default..
-            if (mRawBoard.ep_square() != Stockfish::SQ_NONE)
-            {
-                // Only consider the move when its applicable
-                if ((attackingColour == Stockfish::Color::WHITE && mRawBoard.ep_square() == Stockfish::Square(square + 8))
-                    || (attackingColour == Stockfish::Color::BLACK && mRawBoard.ep_square() == Stockfish::Square(square - 8)))
+                const MoveSpan moves(mOrderedMoves.data(), mOrderedMoves.data() + std::min(limits.mMultiPV, mOrderedMoves.size()));
+                if (onAnalyzed)
                 {
-                    attackingPieces |= mRawBoard.pieces(attackingColour) & Stockfish::pawn_attacks_bb(defendingColour, mRawBoard.ep_square());
+                    onAnalyzed(moves, depth);
                 }
+                bestMoves->set_value(moves.toVector());
             }
-
-            const std::vector<std::pair<Stockfish::Square, Stockfish::Square>> attackersFromToSquare = _getAttackersFromAndToSquare(attackingPieces, square, attackingColour);
-
-            bool isBeingDefended = true;
-            for (const auto& [attackerFromSquare, attackerToSquare] : attackersFromToSquare)
+            catch (...)
             {
-                Stockfish::Bitboard defendingPieces = mRawBoard.attackers_to(attackerToSquare) & mRawBoard.pieces(defendingColour);
-                isBeingDefended = isBeingDefended && _checkIfOnePieceCanDefendSquare(defendingPieces, attackerFromSquare, attackerToSquare, defendingColour);
+                bestMoves->set_exception(std::current_exception());
             }
+        });
 
-            if (!attackersFromToSquare.empty() && !isBeingDefended)
-            {
-                std::optional<Piece>& piece = mBoard[_squareToIndex(square)];
-                assert(piece);
+    return mAsyncAnalysis;
+}
 
-                if (piece)
+Board::SearchResult Board::_search(const AnalysisLimits& limits, const BestMovesCallback& onBestMoves, const std::vector<Stockfish::Move>& expectedLine) const
+{
+    const std::unique_lock<std::mutex> searchLock = SearchPool::lockSearch();
+    SearchPool::start();
+    Stockfish::Search::LimitsType searchLimits = _prepareSearch(limits);
+    searchLimits.expectedLine = expectedLine;
+
+    // every iteration reuses the same moves, the callback only sees them during the call
+    std::array<Move, Stockfish::MAX_MOVES> bestMoves;
+    if (onBestMoves)
+    {
+        searchLimits.onIteration = [&limits, &onBestMoves, &bestMoves](const Stockfish::Search::RootMoves& rootMoves, const Stockfish::Depth depth)
+            {
+                const size_t numMoves = std::min(limits.mMultiPV, rootMoves.size());
+                for (size_t i = 0; i < numMoves; ++i)
                 {
-                    piece->setIsHanging();
+                    bestMoves[i] = rootMoves[i].pv[0];
                 }
-            }
+
+                onBestMoves(MoveSpan(bestMoves.data(), bestMoves.data() + numMoves), depth);
+            };
+    }
+
+    // the search takes ownership of the states it is given, so hand it a copy. mRawBoard keeps pointing at this
+    // board's own states, which means this board stays valid after another board starts a search
+    Stockfish::StateListPtr searchStates = std::make_unique<std::deque<Stockfish::StateInfo>>(1, *mRawBoard.state());
+
+    Stockfish::Threads.start_thinking(mRawBoard, searchStates, searchLimits, false);
+    Stockfish::Threads.main()->wait_for_search_finished();
+    _storeOrderedMoves(Stockfish::Threads.main()->rootMoves);
+
+    SearchResult result;
+    if (!Stockfish::Threads.main()->rootMoves.empty())
+    {
+        result.mPrincipalVariation = Stockfish::Threads.main()->rootMoves[0].pv;
+    }
+    result.mNodes = Stockfish::Threads.nodes_searched();
+
+    return result;
+}
+
+void Board::_waitForAsyncAnalysis() const
+{
+    if (mAsyncAnalysis.valid())
+    {
+        mAsyncAnalysis.wait();
+    }
+}
+
+Stockfish::Search::LimitsType Board::_prepareSearch(const AnalysisLimits& limits)
+{
+    // without a limit nothing would ever stop the search, and without a principal variation there'd be no best move
+    if (!limits.mDepth && !limits.mNodes && !limits.mMoveTime)
+    {
+        throw std::invalid_argument("the analysis needs a depth, node or move time limit");
+    }
+    if (!limits.mMultiPV)
+    {
+        throw std::invalid_argument("the analysis needs at least one principal variation");
+    }
+
+    Stockfish::Search::LimitsType searchLimits;
+    searchLimits.startTime = Stockfish::now();
+    searchLimits.depth = limits.mDepth;
+    searchLimits.nodes = limits.mNodes;
+    searchLimits.movetime = limits.mMoveTime;
+    // MultiPV makes the search give every one of the first mMultiPV moves a full principal variation, so they're all
+    // ordered by their actual score instead of only the best one. It goes with the limits rather than the option, so
+    // the UCI "MultiPV" setting stays whatever it was
+    searchLimits.multiPV = limits.mMultiPV;
+
+    return searchLimits;
+}
+
+void Board::_storeOrderedMoves(const Stockfish::Search::RootMoves& rootMoves) const
+{
+    mPendingAnalysis.reset();
+    mOrderedMoves.clear();
+    for (const Stockfish::Search::RootMove& rootMove : rootMoves)
+    {
+        assert(!rootMove.pv.empty());
+        if (!rootMove.pv.empty() && rootMove.pv[0] != Stockfish::MOVE_NONE)
+        {
+            mOrderedMoves.emplace_back(rootMove.pv[0]);
         }
     }
 }
 
-void Board::_generateLegalMoves()
+// the StateInfo chain kept by do_move already holds the pins and checks of the new position, everything else is
+// worked out again when it's asked for
+void Board::_resetDerivedFacts()
+{
+    mHasLegalMoves.fill(false);
+    mHasHangingPieces.fill(false);
+    mHasCaptureTable = false;
+    mHasCheckMoves = false;
+    mHasCaptureMoves = false;
+    mHangingPieces = 0;
+    mSeeRows = 0;
+    mPendingAnalysis.reset();
+    mOrderedMoves.clear();
+}
+
+void Board::_prepareForSharing() const
+{
+    _requireLegalMoves(Stockfish::WHITE);
+    _requireLegalMoves(Stockfish::BLACK);
+    _requireHangingPieces(Stockfish::WHITE);
+    _requireHangingPieces(Stockfish::BLACK);
+    getCaptureTable();
+    getAllCheckMoves();
+    getAllCaptures();
+
+    mIsShared = true;
+}
+
+void Board::_requireLegalMoves(const Stockfish::Color colour) const
 {
-    constexpr int NUM_PLAYERS = 2; // need to generate moves for both sides
-    for (int i = 0; i < NUM_PLAYERS; ++i)
+    if (!mHasLegalMoves[colour])
+    {
+        _generateLegalMoves(colour);
+        mHasLegalMoves[colour] = true;
+    }
+}
+
+void Board::_requireHangingPieces(const Stockfish::Color defendingColour) const
+{
+    if (!mHasHangingPieces[defendingColour])
+    {
+        _findHangingPieces(defendingColour);
+        mHasHangingPieces[defendingColour] = true;
+    }
+}
+
+void Board::_findHangingPieces(const Stockfish::Color defendingColour) const
+{
+    // a piece is hanging when the opponent can legally capture it and it can't be recaptured. Recaptures by anything
+    // but the king fall out of one defended squares bitboard, so only the captures that are left over need to look at
+    // individual attackers to decide whether the king can take back
+    const Stockfish::Color attackingColour = ~defendingColour;
+    _requireLegalMoves(attackingColour);
+    const Stockfish::Bitboard defendedSquares = _squaresDefendedWithoutKing(defendingColour);
+
+    Stockfish::Bitboard undefendedTargets = mLegalMoveTargets[attackingColour] & mRawBoard.pieces(defendingColour) & ~defendedSquares;
+    while (undefendedTargets)
+    {
+        const Stockfish::Square square = Stockfish::pop_lsb(undefendedTargets);
+        const Stockfish::Bitboard capturingPieces = _legalCapturers(mRawBoard.attackers_to(square) & mRawBoard.pieces(attackingColour), square);
+
+        if (!_kingCanRecapture(square, capturingPieces, square, defendingColour))
+        {
+            mHangingPieces |= Stockfish::square_bb(square);
+        }
+    }
+
+    // en passant captures a pawn that isn't on the square the capturing pawn moves to
+    const Stockfish::Square epSquare = mRawBoard.ep_square();
+    if (epSquare != Stockfish::SQ_NONE && attackingColour == mRawBoard.side_to_move() && !(defendedSquares & epSquare))
     {
-        const Stockfish::MoveList<Stockfish::GenType::LEGAL> moveList(mRawBoard);
+        const Stockfish::Square capturedPawnSquare = epSquare - Stockfish::pawn_push(attackingColour);
+        const Stockfish::Bitboard capturingPawns = _legalCapturers(mRawBoard.pieces(attackingColour, Stockfish::PAWN) & Stockfish::pawn_attacks_bb(defendingColour, epSquare), epSquare);
 
-        for (const Stockfish::ExtMove* extMove = moveList.begin(); extMove != moveList.end(); ++extMove)
+        if (capturingPawns && !_kingCanRecapture(epSquare, capturingPawns, capturedPawnSquare, defendingColour))
         {
-            const Stockfish::Move stockfishMove = extMove->move;
+            mHangingPieces |= Stockfish::square_bb(capturedPawnSquare);
+        }
+    }
+}
 
-            Move legalMove(stockfishMove);
+void Board::_buildCaptureTable() const
+{
+    mCaptures.clear();
+    mCaptureTargets.fill(0);
 
-            std::optional<Piece>& piece = mBoard[_squareToIndex(legalMove.mFromSquare)];
-            assert(piece);
+    // the side to move's moves are grouped by piece, so one pass finds every piece's targets
+    size_t numCaptures = 0;
+    for (const Move* move = _sideToMoveBegin(); move != _sideToMoveEnd(); ++move)
+    {
+        if (mRawBoard.capture(move->stockfishMove()))
+        {
+            Stockfish::Bitboard& targets = mCaptureTargets[_squareToIndex(move->fromSquare())];
+            numCaptures += !(targets & move->toSquare());
+            targets |= move->toSquare();
+        }
+    }
+    mCaptures.reserve(numCaptures);
 
-            if (piece)
+    const Stockfish::Color sideToMove = mRawBoard.side_to_move();
+    Stockfish::Bitboard pieces = mRawBoard.pieces(sideToMove);
+    while (pieces)
+    {
+        const Stockfish::Square from = Stockfish::pop_lsb(pieces);
+        const int fromIndex = _squareToIndex(from);
+        const Stockfish::Bitboard targets = mCaptureTargets[fromIndex];
+        if (!targets)
+        {
+            continue;
+        }
+
+        // a piece captures on at most one square per direction, so there are never more than 8 targets. Placing each
+        // move by its target keeps the entries ordered by square, and the first promotion generated (the queen) wins
+        std::array<Stockfish::Move, 8> moveByTarget = {};
+        for (const Move* move = _movesBegin(from); move != _movesEnd(from); ++move)
+        {
+            const Stockfish::Square to = move->toSquare();
+            if ((targets & to) && mRawBoard.capture(move->stockfishMove()))
             {
-                piece->addLegalMove(std::move(legalMove));
+                Stockfish::Move& slot = moveByTarget[Stockfish::popcount(targets & (Stockfish::square_bb(to) - 1))];
+                if (slot == Stockfish::MOVE_NONE)
+                {
+                    slot = move->stockfishMove();
+                }
             }
         }
 
-        if (i != NUM_PLAYERS - 1)
+        mFirstCapture[fromIndex] = static_cast<uint16_t>(mCaptures.size());
+
+        for (int i = 0; i < Stockfish::popcount(targets); ++i)
+        {
+            const Stockfish::Move move = moveByTarget[i];
+            _addCapture(move, _staticExchangeGain(mRawBoard, move), isPieceHanging(_victimSquare(mRawBoard, move)));
+        }
+    }
+}
+
+void Board::_addCapture(const Stockfish::Move move, const Stockfish::Value exchangeGain, const bool capturesHangingPiece) const
+{
+    const Stockfish::Square victimSquare = _victimSquare(mRawBoard, move);
+    mCaptures.push_back({ Move(move), victimSquare, mRawBoard.piece_on(victimSquare), exchangeGain, capturesHangingPiece });
+}
+
+bool Board::_writeAnalysis(AnalysisRecord& record, const Stockfish::Depth depth, const size_t multiPV) const
+{
+    _requireHangingPieces(Stockfish::WHITE);
+    _requireHangingPieces(Stockfish::BLACK);
+
+    std::vector<Stockfish::Move> moves;
+    moves.reserve(mOrderedMoves.size());
+    for (const Move& move : mOrderedMoves)
+    {
+        moves.push_back(move.stockfishMove());
+    }
+
+    // captures point at their move in the search order
+    std::vector<CaptureRecord> captures;
+    for (const Capture& capture : getCaptureTable())
+    {
+        const auto move = std::find(moves.begin(), moves.end(), capture.mMove.stockfishMove());
+        if (move == moves.end())
         {
-            Stockfish::StateInfo state;
-            mRawBoard.do_null_move(state); // we do a null move to change the players turn so we can generate the moves for the other player
+            return false;
         }
+
+        captures.push_back({ static_cast<uint8_t>(move - moves.begin()), capture.mCapturesHangingPiece, static_cast<int16_t>(capture.mExchangeGain) });
     }
 
-    mRawBoard.undo_null_move(); // have to undo
+    record.mKey = mRawBoard.key();
+    record.mPinnedPieces = (mRawBoard.blockers_for_king(Stockfish::WHITE) & mRawBoard.pieces(Stockfish::WHITE))
+        | (mRawBoard.blockers_for_king(Stockfish::BLACK) & mRawBoard.pieces(Stockfish::BLACK));
+    record.mHangingPieces = mHangingPieces;
+    record.mDepth = static_cast<int16_t>(depth);
+    record.mMultiPV = static_cast<uint8_t>(std::min<size_t>(multiPV, UINT8_MAX));
+
+    return record.setMovesAndCaptures(moves.data(), moves.size(), captures.data(), captures.size());
 }
 
-std::vector<Move> Board::_allPossibleMoves() const
+bool Board::_readAnalysis(const AnalysisRecord& record)
 {
-    std::vector<Move> possibleMoves;
+    // the moves have to be legal here, which also catches two positions sharing a key
+    std::vector<Move> orderedMoves;
+    orderedMoves.reserve(record.mNumMoves);
+    for (size_t i = 0; i < record.mNumMoves; ++i)
+    {
+        const Stockfish::Move move = static_cast<Stockfish::Move>(record.moves()[i]);
+        if (!mRawBoard.pseudo_legal(move) || !mRawBoard.legal(move))
+        {
+            return false;
+        }
+
+        orderedMoves.emplace_back(move);
+    }
+
+    for (size_t i = 0; i < record.mNumCaptures; ++i)
+    {
+        if (record.captures()[i].mMoveIndex >= orderedMoves.size())
+        {
+            return false;
+        }
+    }
+
+    // the legal moves themselves are quicker to generate again than to sort back into place, so only what they lead
+    // to is taken
+    mOrderedMoves = std::move(orderedMoves);
+    mPendingAnalysis.reset();
+    mHangingPieces = record.mHangingPieces;
+    mHasHangingPieces.fill(true);
 
-    for (const std::optional<Piece>& piece : mBoard)
+    mCaptures.clear();
+    mCaptureTargets.fill(0);
+    for (size_t i = 0; i < record.mNumCaptures; ++i)
     {
-        if (piece && piece->colour() == mRawBoard.side_to_move())
+        const CaptureRecord& capture = record.captures()[i];
+        const Stockfish::Move move = mOrderedMoves[capture.mMoveIndex].stockfishMove();
+        const int fromIndex = _squareToIndex(Stockfish::from_sq(move));
+
+        if (!mCaptureTargets[fromIndex])
         {
-            const std::vector<Move>& moves = piece->getLegalMoves();
-            std::copy(moves.begin(), moves.end(), std::back_inserter(possibleMoves));
+            mFirstCapture[fromIndex] = static_cast<uint16_t>(mCaptures.size());
         }
+        mCaptureTargets[fromIndex] |= Stockfish::to_sq(move);
+
+        _addCapture(move, Stockfish::Value(capture.mExchangeGain), capture.mCapturesHangingPiece);
     }
+    mHasCaptureTable = true;
 
-    return possibleMoves;
+    return true;
 }
 
-int Board::_squareToIndex(const Stockfish::Square square) const
+void Board::_generateLegalMoves(const Stockfish::Color colour) const
 {
-    return static_cast<int>(square);
+    if (colour == mRawBoard.side_to_move())
+    {
+        const Stockfish::MoveList<Stockfish::GenType::LEGAL> moves(mRawBoard);
+        _storeMovesBySquare(moves.begin(), moves.end(), colour);
+        return;
+    }
+
+    std::array<Stockfish::ExtMove, Stockfish::MAX_MOVES> moves;
+    const Stockfish::ExtMove* movesEnd = _generateWaitingSideMoves(mRawBoard, colour, moves.data());
+    _storeMovesBySquare(moves.data(), movesEnd, colour);
 }
 
-std::vector<std::pair<Stockfish::Square, Stockfish::Square>> Board::_getAttackersFromAndToSquare(Stockfish::Bitboard& attackingPieces, const Stockfish::Square attackSquare, const Stockfish::Color attackingColour) const
+void Board::_storeMovesBySquare(const Stockfish::ExtMove* begin, const Stockfish::ExtMove* end, const Stockfish::Color colour) const
 {
-    std::vector<std::pair<Stockfish::Square, Stockfish::Square>> attackersFromToSquare;
+    // the squares of the other colour belong to its own generation, so only this colour's pieces are cleared
+    Stockfish::Bitboard pieces = mRawBoard.pieces(colour);
+    while (pieces)
+    {
+        mNumMovesFromSquare[_squareToIndex(Stockfish::pop_lsb(pieces))] = 0;
+    }
+    mLegalMoveTargets[colour] = 0;
+
+    // counting sort on the from square, which keeps the generation order of each piece's moves
+    std::array<uint16_t, Stockfish::SQUARE_NB> numMoves = {};
+    for (const Stockfish::ExtMove* extMove = begin; extMove != end; ++extMove)
+    {
+        ++numMoves[_squareToIndex(Stockfish::from_sq(extMove->move))];
+        mLegalMoveTargets[colour] |= Stockfish::to_sq(extMove->move);
+    }
+
+    std::array<uint16_t, Stockfish::SQUARE_NB> insertIndex;
+    const size_t firstIndex = colour * Stockfish::MAX_MOVES;
+    size_t nextIndex = firstIndex;
+    for (int i = 0; i < Stockfish::SQUARE_NB; ++i)
+    {
+        if (numMoves[i])
+        {
+            mMoveOffsets[i] = static_cast<uint16_t>(nextIndex);
+            mNumMovesFromSquare[i] = static_cast<uint8_t>(numMoves[i]);
+            insertIndex[i] = static_cast<uint16_t>(nextIndex);
+            nextIndex += numMoves[i];
+        }
+    }
+
+    for (const Stockfish::ExtMove* extMove = begin; extMove != end; ++extMove)
+    {
+        mLegalMoves[insertIndex[_squareToIndex(Stockfish::from_sq(extMove->move))]++] = extMove->move;
+    }
+
+    mNumLegalMoves[colour] = nextIndex - firstIndex;
+}
+
+const Move* Board::_movesBegin(const Stockfish::Square square) const
+{
+    const Stockfish::Piece piece = mRawBoard.piece_on(square);
+    if (piece == Stockfish::NO_PIECE)
+    {
+        return mLegalMoves.data();
+    }
+
+    _requireLegalMoves(Stockfish::color_of(piece));
+    return mLegalMoves.data() + mMoveOffsets[_squareToIndex(square)];
+}
 
-    while (attackingPieces)
+const Move* Board::_movesEnd(const Stockfish::Square square) const
+{
+    if (mRawBoard.empty(square))
     {
-        const Stockfish::Square attackingPieceSquare = Stockfish::pop_lsb(attackingPieces);
+        return mLegalMoves.data();
+    }
 
-        const std::optional<Piece>& attackingPiece = mBoard[_squareToIndex(attackingPieceSquare)];
-        assert(attackingPiece);
+    return _movesBegin(square) + mNumMovesFromSquare[_squareToIndex(square)];
+}
 
-        if (attackingPiece)
+bool Board::_canMoveToSquare(const Stockfish::Square from, const Stockfish::Square to) const
+{
+    return std::find_if(_movesBegin(from), _movesEnd(from), [to](const Move move)
         {
-            Stockfish::Square movingToSquare = attackSquare;
+            return to == move.toSquare();
+        }) != _movesEnd(from);
+}
 
-            // handle en passant separately
-            if (attackingPiece->pieceType() == Stockfish::PieceType::PAWN)
-            {
-                if (attackingColour == Stockfish::Color::WHITE && Stockfish::rank_of(attackingPieceSquare) == Stockfish::Rank::RANK_5)
-                {
-                    movingToSquare = Stockfish::Square(attackSquare + 8);
-                }
-                else if (attackingColour == Stockfish::Color::BLACK && Stockfish::rank_of(attackingPieceSquare) == Stockfish::Rank::RANK_3)
-                {
-                    movingToSquare = Stockfish::Square(attackSquare - 8);
-                    
-                }
-            }
+const Move* Board::_sideToMoveBegin() const
+{
+    const Stockfish::Color sideToMove = mRawBoard.side_to_move();
+    _requireLegalMoves(sideToMove);
 
-            if (attackingPiece->canMoveToSquare(movingToSquare))
-            {
-                attackersFromToSquare.emplace_back(attackingPieceSquare, movingToSquare);
-            }
+    return mLegalMoves.data() + sideToMove * Stockfish::MAX_MOVES;
+}
+
+const Move* Board::_sideToMoveEnd() const
+{
+    return _sideToMoveBegin() + mNumLegalMoves[mRawBoard.side_to_move()];
+}
+
+template<typename Filter>
+size_t Board::_filterSideToMoveMoves(std::array<Move, Stockfish::MAX_MOVES>& moves, const Filter filter) const
+{
+    size_t numMoves = 0;
+    for (const Move* move = _sideToMoveBegin(); move != _sideToMoveEnd(); ++move)
+    {
+        if (filter(*move))
+        {
+            moves[numMoves++] = *move;
         }
     }
 
-    return attackersFromToSquare;
+    return numMoves;
+}
+
+int Board::_squareToIndex(const Stockfish::Square square) const
+{
+    return static_cast<int>(square);
 }
 
-bool Board::_checkIfOnePieceCanDefendSquare(Stockfish::Bitboard& defendingPieces, const Stockfish::Square attackingFromSquare, const Stockfish::Square defendingSquare, const Stockfish::Color defensiveColour) const
+Stockfish::Bitboard Board::_squaresDefendedWithoutKing(const Stockfish::Color defendingColour) const
 {
-    while (defendingPieces)
+    const Stockfish::Bitboard occupied = mRawBoard.pieces();
+    const Stockfish::Square kingSquare = mRawBoard.square<Stockfish::KING>(defendingColour);
+    const Stockfish::Bitboard pinnedPieces = mRawBoard.blockers_for_king(defendingColour) & mRawBoard.pieces(defendingColour);
+
+    // pinned pieces can only recapture along the line they're pinned on
+    Stockfish::Bitboard defendedSquares = defendingColour == Stockfish::WHITE
+        ? Stockfish::pawn_attacks_bb<Stockfish::WHITE>(mRawBoard.pieces(Stockfish::WHITE, Stockfish::PAWN) & ~pinnedPieces)
+        : Stockfish::pawn_attacks_bb<Stockfish::BLACK>(mRawBoard.pieces(Stockfish::BLACK, Stockfish::PAWN) & ~pinnedPieces);
+
+    Stockfish::Bitboard pinnedPawns = mRawBoard.pieces(defendingColour, Stockfish::PAWN) & pinnedPieces;
+    while (pinnedPawns)
     {
-        const Stockfish::Square defendingPieceSquare = Stockfish::pop_lsb(defendingPieces);
+        const Stockfish::Square square = Stockfish::pop_lsb(pinnedPawns);
+        defendedSquares |= Stockfish::pawn_attacks_bb(defendingColour, square) & Stockfish::line_bb(kingSquare, square);
+    }
 
-        const std::optional<Piece>& defendingPiece = mBoard[_squareToIndex(defendingPieceSquare)];
-        assert(defendingPiece);
+    Stockfish::Bitboard pieces = mRawBoard.pieces(defendingColour) & ~mRawBoard.pieces(Stockfish::PAWN, Stockfish::KING);
+    while (pieces)
+    {
+        const Stockfish::Square square = Stockfish::pop_lsb(pieces);
+        const Stockfish::Bitboard attacks = Stockfish::attacks_bb(Stockfish::type_of(mRawBoard.piece_on(square)), square, occupied);
 
-        Stockfish::Bitboard kingBoard = mRawBoard.pieces(defensiveColour, Stockfish::PieceType::KING);
-        const Stockfish::Square kingSquare = Stockfish::pop_lsb(kingBoard);
+        defendedSquares |= (pinnedPieces & square) ? attacks & Stockfish::line_bb(kingSquare, square) : attacks;
+    }
 
-        if (defendingPiece)
+    return defendedSquares;
+}
+
+Stockfish::Bitboard Board::_legalCapturers(Stockfish::Bitboard candidates, const Stockfish::Square captureSquare) const
+{
+    Stockfish::Bitboard capturers = 0;
+    while (candidates)
+    {
+        const Stockfish::Square square = Stockfish::pop_lsb(candidates);
+        if (_canMoveToSquare(square, captureSquare))
         {
-            // if piece is pinned, the target square must be aligned with the king for the piece to be able to move
-            if (defendingPiece->isPinned() && !Stockfish::aligned(defendingSquare, defendingPieceSquare, kingSquare))
-            {
-                return false;
-            }
+            capturers |= Stockfish::square_bb(square);
+        }
+    }
 
-            // if king is defending, then the piece it has to attack should not have any defenders after it has taken the piece
-            if (defendingPieceSquare == kingSquare)
-            {
-                const Stockfish::Bitboard piecesAttackingSquareWithCurrentAttackingPieceMissing = mRawBoard.attackers_to(defendingSquare, mRawBoard.pieces(Stockfish::ALL_PIECES) & ~Stockfish::square_bb(attackingFromSquare));
-                const Stockfish::Bitboard defendersOfAttackingPieceAfterItTakes = mRawBoard.pieces(~defensiveColour) & ~Stockfish::square_bb(attackingFromSquare);
-                const Stockfish::Bitboard defendedBoard = piecesAttackingSquareWithCurrentAttackingPieceMissing & defendersOfAttackingPieceAfterItTakes;
+    return capturers;
+}
 
-                return Stockfish::popcount(defendedBoard) == 0;
-            }
+bool Board::_kingCanRecapture(const Stockfish::Square captureSquare, Stockfish::Bitboard capturingPieces, const Stockfish::Square capturedPieceSquare, const Stockfish::Color defendingColour) const
+{
+    if (!(Stockfish::attacks_bb<Stockfish::KING>(mRawBoard.square<Stockfish::KING>(defendingColour)) & captureSquare))
+    {
+        return false;
+    }
 
-            // any other piece attacking this square can take it!
-            return true;
+    // if king is defending, then the piece it has to attack should not have any defenders after it has taken the piece.
+    // Every capturing piece has to be safe to take back, otherwise the opponent just captures with that one
+    const Stockfish::Bitboard attackingPieces = mRawBoard.pieces(~defendingColour);
+    while (capturingPieces)
+    {
+        const Stockfish::Square capturingPieceSquare = Stockfish::pop_lsb(capturingPieces);
+        const Stockfish::Bitboard occupiedAfterCapture = (mRawBoard.pieces() ^ capturingPieceSquare ^ capturedPieceSquare) | captureSquare;
+
+        if (mRawBoard.attackers_to(captureSquare, occupiedAfterCapture) & attackingPieces & ~Stockfish::square_bb(capturingPieceSquare))
+        {
+            return false;
         }
     }
 
-    return false;
+    return true;
 }
@@ -1,14 +1,41 @@
 #pragma once
 
+#include "movegen.h"
 #include "position.h"
-#include "Piece.h"
+#include "search.h"
+#include "CommonData.h"
 
 #include <array>
+#include <future>
+#include <list>
+#include <optional>
+#include <vector>
 
+class AnalysisCache;
+struct AnalysisRecord;
+
+// Only the position itself is set up on construction. Everything derived from it (legal moves of each side, hanging
+// pieces, static exchange results and the search) is worked out the first time a query needs it and kept until the
+// position changes, so a board that is only asked one or two things only pays for those. Because of that, even the
+// const queries of one board must not be called from several threads at once. The exception is analyzeAsync(), whose
+// search runs on the search pool's thread while the queries that don't search are used from this one.
+//
+// Queries that return moves hand out views of the board's own storage (see MoveSpan) instead of copies, so asking
+// doesn't allocate
 class Board
 {
 public:
+    // with analyzeBoard the search with default limits runs on the first call to getBestMoves()
     Board(const std::string& fenString, bool analyzeBoard = true);
+    // analyzes with the given limits right away, streaming the best moves after each completed depth to onBestMoves
+    // if given
+    Board(const std::string& fenString, const AnalysisLimits& limits, const BestMovesCallback& onBestMoves = nullptr);
+    // takes the analysis from cache when it has this position searched at least as deep and with at least as many
+    // principal variations as limits asks for. Otherwise analyzes right away and stores the result in cache. Limits
+    // without a depth always search, a record can't tell whether it is as good as their nodes or time would give
+    Board(const std::string& fenString, const AnalysisLimits& limits, AnalysisCache& cache);
+    // waits for a search started by analyzeAsync()
+    ~Board();
 
     size_t numLegalMovesOfPiece(Stockfish::Square square) const;
     size_t numCapturesPossibleFromPiece(Stockfish::Square square) const;
@@ -16,33 +43,163 @@ public:
     bool isPieceHanging(Stockfish::Square square) const;
     size_t numLegalMovesForPiecesThePieceCanCapture(Stockfish::Square capturingPieceSquare) const;
 
-    // NOTE: only the first 5 moves are ordered properly. Please see _analyzeBoard() for the reason and a potential better solution
-    std::vector<Move> getBestMoves(size_t numMoves) const;
+    // NOTE: only the first AnalysisLimits::mMultiPV moves (5 by default) are ordered properly, the rest keep the order
+    // the search left them in
+    MoveSpan getBestMoves(size_t numMoves) const;
 
     // per Levy Rozman, you should always look for checks then captures first!
-    std::vector<Move> getAllCheckMoves() const;
-    std::vector<Move> getAllCaptures() const;
+    MoveSpan getAllCheckMoves() const;
+    MoveSpan getAllCaptures() const;
+
+    // legal moves of the side to move, grouped by the square they're made from
+    MoveSpan getLegalMoves() const;
+    // legal moves of the piece on square, whichever side it belongs to. Empty if there is no piece
+    MoveSpan getLegalMovesOfPiece(Stockfish::Square square) const;
 
     bool moveCapturesHangingPiece(Stockfish::Square from, Stockfish::Square to) const;
     bool isWinningCaptureStaticExchangeEvaluation(Stockfish::Square from, Stockfish::Square to) const;
 
+    // every capture of the side to move, ordered by the square it's made from and then the square moved to. A pawn
+    // that can capture and promote on the same square is listed once, with the queen promotion
+    const std::vector<Capture>& getCaptureTable() const;
+    // the entry of getCaptureTable() for moving from -> to, nullptr if that isn't a capture of the side to move
+    const Capture* findCapture(Stockfish::Square from, Stockfish::Square to) const;
+
+    std::string fen() const;
+    // Position::key() of the position, the same for boards of the same position however they were set up. Like in
+    // Stockfish's transposition table the move counters are left out, except that from 14 plies on the halfmove clock
+    // changes it every 8 plies
+    Stockfish::Key key() const;
+    // key() of the board fenString would set up, without setting one up. The fields have to be separated by single
+    // spaces
+    static Stockfish::Key keyOf(const std::string& fenString);
+    size_t numLegalMoves() const; // of the side to move
+    // the legal move of the side to move written in standard algebraic notation, as in PGN. Check and annotation
+    // symbols are ignored, a missing promotion piece means a queen. Empty if no legal move matches or several do
+    std::optional<Move> findSanMove(const std::string& san) const;
+
+    // plays a legal move of the side to move on this board, so a game can be walked without rebuilding from FEN.
+    // Everything above then describes the new position, except getBestMoves() which is empty until analyzed again
+    void applyMove(const Move& move);
+    // takes back the last move given to applyMove()
+    void undoMove();
+
+    // (re)runs the search on the current position, replacing what getBestMoves() returns
+    void analyze(const AnalysisLimits& limits, const BestMovesCallback& onBestMoves = nullptr);
+    // like analyze(), but queues the search on the search pool's thread and returns right away, so the queries that
+    // don't search can be answered while it runs. The future gets getBestMoves(limits.mMultiPV) once it's done, after
+    // onAnalyzed (if given) was called with them and the depth searched, from the pool's thread. Until then
+    // getBestMoves(), analyze(), applyMove() and undoMove() wait for it
+    std::shared_future<std::vector<Move>> analyzeAsync(const AnalysisLimits& limits, const BestMovesCallback& onAnalyzed = nullptr);
+
 private:
-    void _analyzeBoard();
-    void _initializePieces();
-    void _initializePinnedPieces();
-    void _initializeHangingPieces();
-    void _generateLegalMoves();
+    friend class AnalysisSession;
+    friend class BoardBatchAnalyzer;
+    friend class BoardCache;
+    friend class FeatureExporter;
+    friend class TacticsScanner;
+
+    // forgets everything derived from mRawBoard, for when the position changes
+    void _resetDerivedFacts();
+    // works out everything queries can ask for up front, after which no const query writes to the board, so it can be
+    // queried from several threads at once
+    void _prepareForSharing() const;
+    // what a search leaves in the shared pool besides the ordered moves, copied out before the pool is released
+    struct SearchResult
+    {
+        std::vector<Stockfish::Move> mPrincipalVariation;
+        uint64_t mNodes = 0;
+    };
+
+    // expectedLine is searched first, see Stockfish::Search::LimitsType::expectedLine
+    SearchResult _search(const AnalysisLimits& limits, const BestMovesCallback& onBestMoves, const std::vector<Stockfish::Move>& expectedLine = {}) const;
+    void _waitForAsyncAnalysis() const;
+
+    // makes sure the legal moves of colour are in mLegalMoves
+    void _requireLegalMoves(Stockfish::Color colour) const;
+    void _generateLegalMoves(Stockfish::Color colour) const;
+    void _storeMovesBySquare(const Stockfish::ExtMove* begin, const Stockfish::ExtMove* end, Stockfish::Color colour) const;
+    void _requireHangingPieces(Stockfish::Color defendingColour) const;
+    void _findHangingPieces(Stockfish::Color defendingColour) const;
+    void _buildCaptureTable() const;
+    void _addCapture(Stockfish::Move move, Stockfish::Value exchangeGain, bool capturesHangingPiece) const;
+
+    // fills record with what has been worked out for this position, false if it doesn't fit in one
+    bool _writeAnalysis(AnalysisRecord& record, Stockfish::Depth depth, size_t multiPV) const;
+    // takes the analysis from record, false if the record doesn't belong to this position
+    bool _readAnalysis(const AnalysisRecord& record);
+
+    // legal moves of the piece on square, empty if there is no piece
+    const Move* _movesBegin(Stockfish::Square square) const;
+    const Move* _movesEnd(Stockfish::Square square) const;
+    bool _canMoveToSquare(Stockfish::Square from, Stockfish::Square to) const;
+    const Move* _sideToMoveBegin() const;
+    const Move* _sideToMoveEnd() const;
+    // the moves of the side to move that pass filter, in moves
+    template<typename Filter>
+    size_t _filterSideToMoveMoves(std::array<Move, Stockfish::MAX_MOVES>& moves, Filter filter) const;
+
+    // Stockfish's limits for a search with the given limits. Throws std::invalid_argument for limits that have no
+    // depth, node or move time limit, or no principal variation
+    static Stockfish::Search::LimitsType _prepareSearch(const AnalysisLimits& limits);
+    // takes the best moves from a finished search of this position
+    void _storeOrderedMoves(const Stockfish::Search::RootMoves& rootMoves) const;
 
-    std::vector<Move> _allPossibleMoves() const;
     int _squareToIndex(Stockfish::Square square) const;
 
-    // [ from, to ]
-    std::vector<std::pair<Stockfish::Square, Stockfish::Square>> _getAttackersFromAndToSquare(Stockfish::Bitboard& attackingPieces, Stockfish::Square attackSquare, Stockfish::Color attackingColour) const;
-    bool _checkIfOnePieceCanDefendSquare(Stockfish::Bitboard& defendingPieces, Stockfish::Square attackingFromSquare, Stockfish::Square defendingSquare, Stockfish::Color defensiveColour) const;
+    Stockfish::Bitboard _squaresDefendedWithoutKing(Stockfish::Color defendingColour) const;
+    Stockfish::Bitboard _legalCapturers(Stockfish::Bitboard candidates, Stockfish::Square captureSquare) const;
+    bool _kingCanRecapture(Stockfish::Square captureSquare, Stockfish::Bitboard capturingPieces, Stockfish::Square capturedPieceSquare, Stockfish::Color defendingColour) const;
 
-    Stockfish::Position mRawBoard;
-    Stockfish::StateListPtr mStateList;
-    std::array<std::optional<Piece>, 64> mBoard;
-    std::vector<Move> mOrderedMoves;
-};
+    // mutable because the search setup needs a non-const Position, it leaves it as it was. Queries never change it, so
+    // separate boards can be built and queried on separate threads
+    mutable Stockfish::Position mRawBoard;
+    Stockfish::StateInfo mRootState; // Board can't be moved (Position isn't), so mRawBoard can point into it directly
+    // one per applied move. A list so states never move while referenced, and boards that never apply a move don't
+    // allocate
+    std::list<Stockfish::StateInfo> mMoveStates;
+    std::vector<Stockfish::Move> mAppliedMoves;
+
+    // everything below is derived from mRawBoard on first use, the flags say what is up to date
+    mutable std::array<bool, Stockfish::COLOR_NB> mHasLegalMoves;
+    mutable std::array<bool, Stockfish::COLOR_NB> mHasHangingPieces;
+    mutable bool mHasCaptureTable;
+    mutable bool mHasCheckMoves;
+    mutable bool mHasCaptureMoves;
+
+    // legal moves of both players in one buffer, each colour has its own half. Within a player, moves are grouped by
+    // the square they move from so that every piece's moves are one contiguous range
+    mutable std::array<Move, Stockfish::COLOR_NB * Stockfish::MAX_MOVES> mLegalMoves;
+    mutable std::array<uint16_t, Stockfish::SQUARE_NB> mMoveOffsets;
+    mutable std::array<uint8_t, Stockfish::SQUARE_NB> mNumMovesFromSquare;
+    mutable std::array<size_t, Stockfish::COLOR_NB> mNumLegalMoves;
+    mutable std::array<Stockfish::Bitboard, Stockfish::COLOR_NB> mLegalMoveTargets;
 
+    mutable Stockfish::Bitboard mHangingPieces;
+
+    // the moves of the side to move that give check and that capture, in the order of mLegalMoves
+    mutable std::array<Move, Stockfish::MAX_MOVES> mCheckMoves;
+    mutable std::array<Move, Stockfish::MAX_MOVES> mCaptureMoves;
+    mutable size_t mNumCheckMoves;
+    mutable size_t mNumCaptureMoves;
+
+    // for every square of the side to move, the squares its piece captures on and the index of its first capture in
+    // mCaptures, so a capture is found by counting the targets before it
+    mutable std::vector<Capture> mCaptures;
+    mutable std::array<Stockfish::Bitboard, Stockfish::SQUARE_NB> mCaptureTargets;
+    mutable std::array<uint16_t, Stockfish::SQUARE_NB> mFirstCapture;
+
+    // static exchange results of moves that aren't in mCaptures, row by from square. mSeeRows says which rows have
+    // been started since the last reset, so resetting doesn't have to clear them all
+    mutable Stockfish::Bitboard mSeeRows;
+    mutable std::array<Stockfish::Bitboard, Stockfish::SQUARE_NB> mSeeKnown;
+    mutable std::array<Stockfish::Bitboard, Stockfish::SQUARE_NB> mSeeWinning;
+    // a shared board works static exchanges out every time instead of remembering them
+    mutable bool mIsShared;
+
+    // limits of a search that was asked for but hasn't run yet
+    mutable std::optional<AnalysisLimits> mPendingAnalysis;
+    mutable std::vector<Move> mOrderedMoves;
+    // the search queued by analyzeAsync(), invalid if there never was one
+    std::shared_future<std::vector<Move>> mAsyncAnalysis;
+};
@@ -0,0 +1,191 @@
+#include "BoardBatchAnalyzer.h"
+
+#include "thread.h"
+
+#include "SearchPool.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+    double _secondsSince(const std::chrono::steady_clock::time_point start)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+}
+
+double BatchStatistics::positionsPerSecond() const
+{
+    if (mElapsedSeconds <= 0.0)
+    {
+        return 0.0;
+    }
+
+    return static_cast<double>(mNumPositions) / mElapsedSeconds;
+}
+
+BoardBatchAnalyzer::BoardBatchAnalyzer(const bool analyzeBoards)
+    : mAnalyzeBoards(analyzeBoards)
+    , mOnePositionPerThread(false)
+    , mLimits()
+    , mBoards()
+    , mStreamedBoard()
+    , mStatistics()
+{
+
+}
+
+BoardBatchAnalyzer::BoardBatchAnalyzer(const AnalysisLimits& limits)
+    : mAnalyzeBoards(true)
+    , mOnePositionPerThread(true)
+    , mLimits(limits)
+    , mBoards()
+    , mStreamedBoard()
+    , mStatistics()
+{
+
+}
+
+const std::deque<Board>& BoardBatchAnalyzer::analyze(const std::vector<std::string>& fenStrings)
+{
+    _startBatch();
+    const auto start = std::chrono::steady_clock::now();
+
+    mBoards.clear();
+    for (const std::string& fenString : fenStrings)
+    {
+        mBoards.emplace_back(fenString, false);
+        if (mAnalyzeBoards && !mOnePositionPerThread)
+        {
+            // boards only search when first asked for their best moves, a batch does it right away
+            mBoards.back().analyze(AnalysisLimits());
+        }
+    }
+
+    if (mOnePositionPerThread)
+    {
+        _searchInParallel(fenStrings, 0);
+    }
+
+    mStatistics.mNumPositions = fenStrings.size();
+    mStatistics.mElapsedSeconds = _secondsSince(start);
+
+    return mBoards;
+}
+
+void BoardBatchAnalyzer::analyze(std::istream& fenStream, const std::function<void(const Board&)>& onBoardAnalyzed)
+{
+    _startBatch();
+    const auto start = std::chrono::steady_clock::now();
+
+    // positions searched in parallel are read in groups of one per thread, the boards of a group are handed out once
+    // the whole group is done. Should the number of threads change meanwhile, _searchInParallel() still splits the
+    // group to fit
+    std::vector<std::string> pendingFens;
+    const size_t groupSize = mOnePositionPerThread ? _numThreads() : 1;
+    const auto analyzePendingFens = [this, &pendingFens, &onBoardAnalyzed]()
+        {
+            mBoards.clear();
+            for (const std::string& fenString : pendingFens)
+            {
+                mBoards.emplace_back(fenString, false);
+            }
+
+            _searchInParallel(pendingFens, 0);
+            mStatistics.mNumPositions += pendingFens.size();
+            pendingFens.clear();
+
+            for (const Board& board : mBoards)
+            {
+                onBoardAnalyzed(board);
+            }
+        };
+
+    std::string fenString;
+    while (std::getline(fenStream, fenString))
+    {
+        if (fenString.find_first_not_of(" \t\r") == std::string::npos)
+        {
+            continue;
+        }
+
+        if (mOnePositionPerThread)
+        {
+            pendingFens.push_back(fenString);
+            if (pendingFens.size() == groupSize)
+            {
+                analyzePendingFens();
+            }
+            continue;
+        }
+
+        // Board can't be moved or assigned, so the same storage is rebuilt in place for every position
+        mStreamedBoard.emplace(fenString, false);
+        if (mAnalyzeBoards)
+        {
+            mStreamedBoard->analyze(AnalysisLimits());
+        }
+        ++mStatistics.mNumPositions;
+
+        onBoardAnalyzed(*mStreamedBoard);
+    }
+
+    if (!pendingFens.empty())
+    {
+        analyzePendingFens();
+    }
+
+    mBoards.clear();
+    mStreamedBoard.reset();
+    mStatistics.mElapsedSeconds = _secondsSince(start);
+}
+
+const BatchStatistics& BoardBatchAnalyzer::statistics() const
+{
+    return mStatistics;
+}
+
+void BoardBatchAnalyzer::_startBatch()
+{
+    // the pool is shared with any board analyzed outside of the batch, make sure it's idle before reusing it
+    if (mOnePositionPerThread)
+    {
+        SearchPool::start();
+    }
+    SearchPool::waitForSearchFinished();
+
+    mStatistics = BatchStatistics();
+}
+
+void BoardBatchAnalyzer::_searchInParallel(const std::vector<std::string>& fenStrings, const size_t firstBoard)
+{
+    if (fenStrings.empty())
+    {
+        return;
+    }
+
+    // the number of threads is only read under the search lock, which keeps configure() from changing it until the
+    // last group is done
+    const std::unique_lock<std::mutex> searchLock = SearchPool::lockSearch();
+    SearchPool::start();
+    const size_t numThreads = Stockfish::Threads.size();
+    for (size_t first = 0; first < fenStrings.size(); first += numThreads)
+    {
+        const size_t last = std::min(first + numThreads, fenStrings.size());
+        Stockfish::Threads.start_thinking(std::vector<std::string>(fenStrings.begin() + first, fenStrings.begin() + last),
+            Board::_prepareSearch(mLimits));
+        Stockfish::Threads.main()->wait_for_search_finished();
+
+        for (size_t i = first; i < last; ++i)
+        {
+            mBoards[firstBoard + i]._storeOrderedMoves(Stockfish::Threads[i - first]->rootMoves);
+        }
+    }
+}
+
+size_t BoardBatchAnalyzer::_numThreads()
+{
+    const std::unique_lock<std::mutex> searchLock = SearchPool::lockSearch();
+    return Stockfish::Threads.size();
+}
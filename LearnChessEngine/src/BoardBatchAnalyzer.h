@@ -0,0 +1,57 @@
+#pragma once
+
+#include "Board.h"
+
+#include <deque>
+#include <functional>
+#include <istream>
+#include <optional>
+#include <string>
+#include <vector>
+
+struct BatchStatistics
+{
+    double positionsPerSecond() const;
+
+    size_t mNumPositions = 0;
+    double mElapsedSeconds = 0.0;
+};
+
+// Runs many positions through Board while paying the engine setup once per batch instead of once per position.
+// The search pool is shared by every position (it is only waited on, never rebuilt) and Board storage is reused
+// between positions, so batch jobs are dominated by the analysis itself
+class BoardBatchAnalyzer
+{
+public:
+    // every position gets the whole search pool, one position after the other
+    explicit BoardBatchAnalyzer(bool analyzeBoards = true);
+    // every search thread analyzes a position of its own with the given limits, so as many positions as there are
+    // threads are analyzed at once. Threads only share the transposition table, which scales far better than all of
+    // them searching the same position
+    explicit BoardBatchAnalyzer(const AnalysisLimits& limits);
+
+    // the returned boards are in the same order as fenStrings and stay valid until the next call to analyze()
+    const std::deque<Board>& analyze(const std::vector<std::string>& fenStrings);
+
+    // reads one FEN per line, skipping empty lines. The board handed to the callback is only valid during the call,
+    // its storage is reused for the next position
+    void analyze(std::istream& fenStream, const std::function<void(const Board&)>& onBoardAnalyzed);
+
+    // statistics of the last call to analyze()
+    const BatchStatistics& statistics() const;
+
+private:
+    void _startBatch();
+    // searches fenStrings, one per thread and as many groups of them as it takes, and gives the results to the boards
+    // starting at mBoards[firstBoard]
+    void _searchInParallel(const std::vector<std::string>& fenStrings, size_t firstBoard);
+    // the search threads there are now, read under the search lock
+    static size_t _numThreads();
+
+    bool mAnalyzeBoards;
+    bool mOnePositionPerThread;
+    AnalysisLimits mLimits;
+    std::deque<Board> mBoards;
+    std::optional<Board> mStreamedBoard;
+    BatchStatistics mStatistics;
+};
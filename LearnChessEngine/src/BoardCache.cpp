@@ -0,0 +1,179 @@
+#include "BoardCache.h"
+
+#include <algorithm>
+
+double BoardCacheStatistics::hitRate() const
+{
+    const uint64_t numLookups = mNumHits + mNumMisses;
+    if (!numLookups)
+    {
+        return 0.0;
+    }
+
+    return static_cast<double>(mNumHits) / static_cast<double>(numLookups);
+}
+
+BoardCache::BoardCache(const size_t capacity)
+    : mShards()
+    , mCapacity(0)
+    , mShardCapacity(std::max<size_t>(1, (capacity + NumShards - 1) / NumShards))
+    , mAnalysisMutex()
+{
+    mCapacity = mShardCapacity * NumShards;
+}
+
+std::shared_ptr<const Board> BoardCache::get(const std::string& fenString, const AnalysisLimits& limits)
+{
+    const CacheKey key = _cacheKey(Board::keyOf(fenString), limits);
+    if (std::shared_ptr<const Board> board = _find(key, true))
+    {
+        return board;
+    }
+
+    // boards are analyzed one at a time, by the time it's this one's turn another thread may have added it
+    std::lock_guard<std::mutex> lock(mAnalysisMutex);
+    if (std::shared_ptr<const Board> board = _find(key, false))
+    {
+        return board;
+    }
+
+    std::shared_ptr<Board> board = std::make_shared<Board>(fenString, limits);
+    board->_prepareForSharing();
+
+    return _insert(key, std::move(board));
+}
+
+std::shared_ptr<const Board> BoardCache::get(const std::string& fenString)
+{
+    const CacheKey key = _cacheKey(Board::keyOf(fenString), std::nullopt);
+    if (std::shared_ptr<const Board> board = _find(key, true))
+    {
+        return board;
+    }
+
+    // nothing searches, so threads can set up boards at the same time
+    std::shared_ptr<Board> board = std::make_shared<Board>(fenString, false);
+    board->_prepareForSharing();
+
+    return _insert(key, std::move(board));
+}
+
+std::shared_ptr<const Board> BoardCache::find(const Stockfish::Key key, const std::optional<AnalysisLimits>& limits)
+{
+    return _find(_cacheKey(key, limits), true);
+}
+
+size_t BoardCache::size() const
+{
+    size_t numBoards = 0;
+    for (const Shard& shard : mShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mMutex);
+        numBoards += shard.mEntries.size();
+    }
+
+    return numBoards;
+}
+
+size_t BoardCache::capacity() const
+{
+    return mCapacity;
+}
+
+BoardCacheStatistics BoardCache::statistics() const
+{
+    BoardCacheStatistics statistics;
+    for (const Shard& shard : mShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mMutex);
+        statistics.mNumHits += shard.mStatistics.mNumHits;
+        statistics.mNumMisses += shard.mStatistics.mNumMisses;
+        statistics.mNumEvictions += shard.mStatistics.mNumEvictions;
+    }
+
+    return statistics;
+}
+
+void BoardCache::clear()
+{
+    for (Shard& shard : mShards)
+    {
+        std::lock_guard<std::mutex> lock(shard.mMutex);
+        shard.mIndex.clear();
+        shard.mEntries.clear();
+    }
+}
+
+bool BoardCache::CacheKey::operator==(const CacheKey& other) const
+{
+    return mPositionKey == other.mPositionKey && mDepth == other.mDepth && mNodes == other.mNodes
+        && mMoveTime == other.mMoveTime && mMultiPV == other.mMultiPV;
+}
+
+size_t BoardCache::CacheKeyHash::operator()(const CacheKey& key) const
+{
+    // the position key is already random, the limits only have to move it somewhere else
+    return static_cast<size_t>(key.mPositionKey
+        ^ (static_cast<uint64_t>(key.mDepth) * 0x9E3779B97F4A7C15ULL)
+        ^ (static_cast<uint64_t>(key.mNodes) * 0xC2B2AE3D27D4EB4FULL)
+        ^ (static_cast<uint64_t>(key.mMoveTime) * 0x165667B19E3779F9ULL)
+        ^ (static_cast<uint64_t>(key.mMultiPV) * 0x27D4EB2F165667C5ULL));
+}
+
+BoardCache::CacheKey BoardCache::_cacheKey(const Stockfish::Key positionKey, const std::optional<AnalysisLimits>& limits)
+{
+    if (!limits)
+    {
+        return { positionKey, 0, 0, 0, 0 };
+    }
+
+    return { positionKey, limits->mDepth, limits->mNodes, limits->mMoveTime, limits->mMultiPV };
+}
+
+BoardCache::Shard& BoardCache::_shardOf(const CacheKey& key)
+{
+    // the hash table of a shard buckets by the low bits, so the shard is picked by the high ones
+    return mShards[(key.mPositionKey >> 60) % NumShards];
+}
+
+std::shared_ptr<const Board> BoardCache::_find(const CacheKey& key, const bool countLookup)
+{
+    Shard& shard = _shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+
+    const auto entry = shard.mIndex.find(key);
+    if (entry == shard.mIndex.end())
+    {
+        shard.mStatistics.mNumMisses += countLookup;
+        return nullptr;
+    }
+
+    shard.mStatistics.mNumHits += countLookup;
+    shard.mEntries.splice(shard.mEntries.begin(), shard.mEntries, entry->second);
+    return entry->second->mBoard;
+}
+
+std::shared_ptr<const Board> BoardCache::_insert(const CacheKey& key, std::shared_ptr<const Board> board)
+{
+    Shard& shard = _shardOf(key);
+    std::lock_guard<std::mutex> lock(shard.mMutex);
+
+    const auto existing = shard.mIndex.find(key);
+    if (existing != shard.mIndex.end())
+    {
+        return existing->second->mBoard;
+    }
+
+    shard.mEntries.push_front({ key, std::move(board) });
+    shard.mIndex.emplace(key, shard.mEntries.begin());
+
+    // boards still held by callers stay alive after being dropped here
+    while (shard.mEntries.size() > mShardCapacity)
+    {
+        shard.mIndex.erase(shard.mEntries.back().mKey);
+        shard.mEntries.pop_back();
+        ++shard.mStatistics.mNumEvictions;
+    }
+
+    return shard.mEntries.front().mBoard;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "Board.h"
+#include "CommonData.h"
+
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+struct BoardCacheStatistics
+{
+    double hitRate() const;
+
+    uint64_t mNumHits = 0;
+    uint64_t mNumMisses = 0;
+    uint64_t mNumEvictions = 0;
+};
+
+// Keeps the boards of recently asked for positions in memory, so a position that comes up again (puzzle corpora and
+// game databases are full of them) is neither set up nor analyzed again. Boards are keyed by their position's key
+// together with the analysis limits they were searched with, and a position found in the cache costs a hash lookup,
+// without even setting up a Position from its FEN.
+//
+// The cache holds at most capacity boards (rounded up to a multiple of its number of shards) and drops the least
+// recently used ones beyond that. It can be used from several threads at once: lookups only lock the shard of the
+// cache their key falls in, and the boards it hands out have everything worked out before they are shared, so their
+// const queries can be called from several threads too.
+// Boards that aren't cached yet are analyzed one at a time, since they all search with Stockfish's global thread pool.
+//
+// Unlike AnalysisCache this keeps whole boards and nothing is written to disk, a few kilobytes per board
+class BoardCache
+{
+public:
+    explicit BoardCache(size_t capacity = 4096);
+
+    BoardCache(const BoardCache&) = delete;
+    BoardCache& operator=(const BoardCache&) = delete;
+
+    // the board of fenString searched with limits, analyzed now if it isn't cached
+    std::shared_ptr<const Board> get(const std::string& fenString, const AnalysisLimits& limits);
+    // the board of fenString without a search, its getBestMoves() is empty
+    std::shared_ptr<const Board> get(const std::string& fenString);
+
+    // the cached board of the position with this key (see Board::key()), nullptr if there is none. Limits are the ones
+    // it was searched with, nullopt for a board without a search
+    std::shared_ptr<const Board> find(Stockfish::Key key, const std::optional<AnalysisLimits>& limits);
+
+    size_t size() const;
+    size_t capacity() const;
+    // counted over every call to get() and find()
+    BoardCacheStatistics statistics() const;
+    void clear();
+
+private:
+    static constexpr size_t NumShards = 16;
+
+    struct CacheKey
+    {
+        bool operator==(const CacheKey& other) const;
+
+        Stockfish::Key mPositionKey;
+        int mDepth;
+        int64_t mNodes;
+        Stockfish::TimePoint mMoveTime;
+        size_t mMultiPV; // 0 for a board without a search
+    };
+
+    struct CacheKeyHash
+    {
+        size_t operator()(const CacheKey& key) const;
+    };
+
+    struct Entry
+    {
+        CacheKey mKey;
+        std::shared_ptr<const Board> mBoard;
+    };
+
+    // the most recently used entry is at the front of mEntries
+    struct Shard
+    {
+        mutable std::mutex mMutex;
+        std::list<Entry> mEntries;
+        std::unordered_map<CacheKey, std::list<Entry>::iterator, CacheKeyHash> mIndex;
+        BoardCacheStatistics mStatistics;
+    };
+
+    static CacheKey _cacheKey(Stockfish::Key positionKey, const std::optional<AnalysisLimits>& limits);
+    Shard& _shardOf(const CacheKey& key);
+    // countLookup is false when a lookup that was already counted is repeated
+    std::shared_ptr<const Board> _find(const CacheKey& key, bool countLookup);
+    // when another thread added the same board first, that one is kept and returned
+    std::shared_ptr<const Board> _insert(const CacheKey& key, std::shared_ptr<const Board> board);
+
+    std::array<Shard, NumShards> mShards;
+    size_t mCapacity;
+    size_t mShardCapacity;
+    std::mutex mAnalysisMutex;
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Hands items from one thread to another, holding at most a fixed number of them. A producer that gets ahead blocks
+// until the consumer catches up, so a pipeline of these uses the same memory however much goes through it
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(const size_t capacity)
+        : mCapacity(capacity ? capacity : 1)
+        , mClosed(false)
+    {
+
+    }
+
+    // waits while the queue is full
+    void push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mNotFull.wait(lock, [this]() { return mItems.size() < mCapacity; });
+
+        mItems.push_back(std::move(item));
+        mNotEmpty.notify_one();
+    }
+
+    // waits while the queue is empty, false once it is closed and everything pushed has been taken
+    bool pop(T& item)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mNotEmpty.wait(lock, [this]() { return !mItems.empty() || mClosed; });
+
+        if (mItems.empty())
+        {
+            return false;
+        }
+
+        item = std::move(mItems.front());
+        mItems.pop_front();
+        mNotFull.notify_one();
+        return true;
+    }
+
+    // called by the producer once it's done
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mClosed = true;
+        mNotEmpty.notify_all();
+    }
+
+private:
+    std::mutex mMutex;
+    std::condition_variable mNotFull;
+    std::condition_variable mNotEmpty;
+    std::deque<T> mItems;
+    const size_t mCapacity;
+    bool mClosed;
+};
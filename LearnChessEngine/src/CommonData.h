@@ -1,21 +1,191 @@
 #pragma once
+#include "misc.h"
 #include "types.h"
 
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// a move in the 16 bits Stockfish encodes it in (see Stockfish::Move), decoded when asked. A list of them is half the
+// size of one of Stockfish::Move, so the moves of a position take a cache line or two
 struct Move
 {
-    Move(const Stockfish::Move& move)
-        : mStockfishMove(move)
-        , mFromSquare(Stockfish::from_sq(move))
-        , mToSquare(Stockfish::to_sq(move))
-        , mTypeOfMove(Stockfish::type_of(move))
-        , mPromotionType(Stockfish::promotion_type(move))
-    {            
+    constexpr Move()
+        : mData(0)
+    {
+
+    }
+
+    constexpr Move(const Stockfish::Move move)
+        : mData(static_cast<uint16_t>(move))
+    {
+
+    }
+
+    constexpr Stockfish::Move stockfishMove() const
+    {
+        return Stockfish::Move(mData);
+    }
+
+    constexpr Stockfish::Square fromSquare() const
+    {
+        return Stockfish::from_sq(stockfishMove());
+    }
+
+    constexpr Stockfish::Square toSquare() const
+    {
+        return Stockfish::to_sq(stockfishMove());
+    }
+
+    constexpr Stockfish::MoveType typeOfMove() const
+    {
+        return Stockfish::type_of(stockfishMove());
+    }
+
+    // only meaningful for promotions
+    constexpr Stockfish::PieceType promotionType() const
+    {
+        return Stockfish::promotion_type(stockfishMove());
+    }
 
+    constexpr bool operator==(const Move other) const
+    {
+        return mData == other.mData;
     }
 
-    Stockfish::Move mStockfishMove;
-    Stockfish::Square mFromSquare;
-    Stockfish::Square mToSquare;
-    Stockfish::MoveType mTypeOfMove;
-    Stockfish::PieceType mPromotionType;
+    constexpr bool operator!=(const Move other) const
+    {
+        return mData != other.mData;
+    }
+
+    uint16_t mData;
 };
+
+static_assert(sizeof(Move) == 2, "moves are stored packed");
+
+// moves stored in the Board that returned them, so nothing is copied. Only valid until that board's position
+// changes, it is analyzed again or it is destroyed
+class MoveSpan
+{
+public:
+    constexpr MoveSpan()
+        : mBegin(nullptr)
+        , mEnd(nullptr)
+    {
+
+    }
+
+    constexpr MoveSpan(const Move* begin, const Move* end)
+        : mBegin(begin)
+        , mEnd(end)
+    {
+
+    }
+
+    constexpr const Move* begin() const { return mBegin; }
+    constexpr const Move* end() const { return mEnd; }
+    constexpr size_t size() const { return static_cast<size_t>(mEnd - mBegin); }
+    constexpr bool empty() const { return mBegin == mEnd; }
+    constexpr const Move& operator[](const size_t index) const { return mBegin[index]; }
+    constexpr const Move& front() const { return *mBegin; }
+
+    bool contains(const Move move) const
+    {
+        for (const Move& spanMove : *this)
+        {
+            if (spanMove == move)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // a copy that outlives the board
+    std::vector<Move> toVector() const
+    {
+        return std::vector<Move>(mBegin, mEnd);
+    }
+
+private:
+    const Move* mBegin;
+    const Move* mEnd;
+};
+
+// a capture the side to move can make, with what it wins
+struct Capture
+{
+    Move mMove;
+    Stockfish::Square mVictimSquare; // not the square moved to for en passant
+    Stockfish::Piece mVictim;
+    // material won by the capturing side (negative when it loses material) once the exchange on the square is played
+    // out, in middlegame piece values. En passant and promotions count as an even trade, like in the search
+    Stockfish::Value mExchangeGain;
+    bool mCapturesHangingPiece;
+
+    bool isWinningExchange() const
+    {
+        return mExchangeGain >= Stockfish::VALUE_ZERO;
+    }
+};
+
+// a move that attacks two or more pieces worth attacking (see TacticsScanner) from a square it can't simply be taken on
+struct Fork
+{
+    Move mMove;
+    Stockfish::Bitboard mForkedPieces;
+};
+
+// a slider move attacking a piece that has to get out of the way of a less valuable one behind it
+struct Skewer
+{
+    Move mMove;
+    Stockfish::Square mFrontPiece;
+    Stockfish::Square mPieceBehind;
+};
+
+// the only piece between one of our sliders and a target, so moving it off the line attacks the target
+struct DiscoveredAttack
+{
+    Stockfish::Square mMovingPiece;
+    Stockfish::Square mSlider;
+    Stockfish::Square mTarget;
+};
+
+// an opponent piece that is the only defender of several attacked pieces, so it can't hold all of them
+struct OverloadedDefender
+{
+    Stockfish::Square mDefender;
+    Stockfish::Bitboard mDefendedPieces;
+};
+
+// every motif the side to move can use in a position
+struct Tactics
+{
+    bool empty() const
+    {
+        return mForks.empty() && mSkewers.empty() && mDiscoveredAttacks.empty() && mOverloadedDefenders.empty();
+    }
+
+    std::vector<Fork> mForks;
+    std::vector<Skewer> mSkewers;
+    std::vector<DiscoveredAttack> mDiscoveredAttacks;
+    std::vector<OverloadedDefender> mOverloadedDefenders;
+};
+
+struct AnalysisLimits
+{
+    // the search stops at whichever limit is hit first. Zero means no limit, but at least one of them has to be set,
+    // searching with none of them (or with mMultiPV 0) throws std::invalid_argument
+    int mDepth = 12; // depth 12 so it's quick to iterate
+    int64_t mNodes = 0;
+    Stockfish::TimePoint mMoveTime = 0; // milliseconds
+
+    // how many of the best moves are searched as principal variations, and therefore ordered properly
+    size_t mMultiPV = 5;
+};
+
+// receives the best moves (up to AnalysisLimits::mMultiPV of them) every time the search completes a depth, they are
+// only valid during the call
+using BestMovesCallback = std::function<void(MoveSpan bestMoves, int depth)>;
@@ -0,0 +1,82 @@
+#include "FeatureExporter.h"
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+    int8_t* _plane(int8_t* const features, const FeaturePlane plane)
+    {
+        return features + plane * Stockfish::SQUARE_NB;
+    }
+
+    void _exportBitboard(const Stockfish::Bitboard bitboard, int8_t* const plane)
+    {
+        for (int square = 0; square < Stockfish::SQUARE_NB; ++square)
+        {
+            plane[square] = static_cast<int8_t>((bitboard >> square) & 1);
+        }
+    }
+}
+
+void FeatureExporter::exportBoard(const Board& board, int8_t* const features)
+{
+    const Stockfish::Position& position = board.mRawBoard;
+    for (const Stockfish::Color colour : { Stockfish::WHITE, Stockfish::BLACK })
+    {
+        board._requireLegalMoves(colour);
+        board._requireHangingPieces(colour);
+    }
+
+    // the move counts of empty squares are left over from earlier positions, so they're masked out
+    const Stockfish::Bitboard occupied = position.pieces();
+    int8_t* const pieces = _plane(features, PiecePlane);
+    int8_t* const legalMoves = _plane(features, LegalMovesPlane);
+    for (int square = 0; square < Stockfish::SQUARE_NB; ++square)
+    {
+        const int8_t mask = static_cast<int8_t>(-static_cast<int>((occupied >> square) & 1));
+        pieces[square] = static_cast<int8_t>(position.piece_on(Stockfish::Square(square)));
+        legalMoves[square] = static_cast<int8_t>(board.mNumMovesFromSquare[square]) & mask;
+    }
+
+    int8_t* const captures = _plane(features, CapturesPlane);
+    std::fill(captures, captures + Stockfish::SQUARE_NB, int8_t(0));
+    for (const Stockfish::Color colour : { Stockfish::WHITE, Stockfish::BLACK })
+    {
+        const Move* const movesBegin = board.mLegalMoves.data() + colour * Stockfish::MAX_MOVES;
+        for (const Move* move = movesBegin; move != movesBegin + board.mNumLegalMoves[colour]; ++move)
+        {
+            captures[move->fromSquare()] += position.capture(move->stockfishMove());
+        }
+    }
+
+    const Stockfish::Bitboard pinned = (position.blockers_for_king(Stockfish::WHITE) & position.pieces(Stockfish::WHITE))
+        | (position.blockers_for_king(Stockfish::BLACK) & position.pieces(Stockfish::BLACK));
+    _exportBitboard(pinned, _plane(features, PinnedPlane));
+    _exportBitboard(board.mHangingPieces, _plane(features, HangingPlane));
+
+    int8_t* const attackers = _plane(features, AttackersPlane);
+    int8_t* const defenders = _plane(features, DefendersPlane);
+    std::fill(attackers, attackers + Stockfish::SQUARE_NB, int8_t(0));
+    std::fill(defenders, defenders + Stockfish::SQUARE_NB, int8_t(0));
+    Stockfish::Bitboard remaining = occupied;
+    while (remaining)
+    {
+        const Stockfish::Square square = Stockfish::pop_lsb(remaining);
+        const Stockfish::Color colour = Stockfish::color_of(position.piece_on(square));
+        const Stockfish::Bitboard attackedBy = position.attackers_to(square);
+        attackers[square] = static_cast<int8_t>(Stockfish::popcount(attackedBy & position.pieces(~colour)));
+        defenders[square] = static_cast<int8_t>(Stockfish::popcount(attackedBy & position.pieces(colour)));
+    }
+}
+
+void FeatureExporter::exportBoard(const Board& board, float* const features)
+{
+    std::array<int8_t, NumFeatures> integerFeatures;
+    exportBoard(board, integerFeatures.data());
+
+    for (size_t i = 0; i < NumFeatures; ++i)
+    {
+        features[i] = static_cast<float>(integerFeatures[i]);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Board.h"
+#include "CommonData.h"
+
+#include <cstdint>
+
+// the planes of an exported board, 64 values each indexed by Stockfish::Square (a1 = 0, h8 = 63). Every plane but
+// PiecePlane describes the piece on the square and is 0 for empty squares
+enum FeaturePlane
+{
+    PiecePlane, // the Stockfish::Piece on the square, NO_PIECE (0) when empty
+    LegalMovesPlane, // numLegalMovesOfPiece()
+    CapturesPlane, // numCapturesPossibleFromPiece()
+    PinnedPlane, // isPiecePinned(), 0 or 1
+    HangingPlane, // isPieceHanging(), 0 or 1
+    AttackersPlane, // opponent pieces attacking the piece
+    DefendersPlane, // pieces of its own colour defending it
+    FeaturePlaneNb
+};
+
+// Writes the per piece queries of Board for every square at once into a buffer the caller owns, laid out plane by
+// plane (board, plane, square), which is what ML frameworks take as an N x C x 8 x 8 tensor. The features are read
+// straight from the bitboards and the legal moves Board keeps, instead of 64 calls per query that each look up the
+// piece on their square again
+class FeatureExporter
+{
+public:
+    static constexpr size_t NumFeatures = FeaturePlaneNb * Stockfish::SQUARE_NB; // of one board
+
+    // writes the features of board to features[0, NumFeatures)
+    static void exportBoard(const Board& board, int8_t* features);
+    static void exportBoard(const Board& board, float* features);
+
+    // boards is any container of Board (like the std::deque BoardBatchAnalyzer returns), the features of its i-th
+    // board go to features + i * NumFeatures
+    template<typename Boards, typename Feature>
+    static void exportBatch(const Boards& boards, Feature* features)
+    {
+        for (const Board& board : boards)
+        {
+            exportBoard(board, features);
+            features += NumFeatures;
+        }
+    }
+};
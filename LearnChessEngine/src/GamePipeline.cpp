@@ -0,0 +1,276 @@
+#include "GamePipeline.h"
+
+#include "Board.h"
+#include "BoardBatchAnalyzer.h"
+#include "BoundedQueue.h"
+#include "TacticsScanner.h"
+#include "uci.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <thread>
+
+namespace
+{
+    void _readGames(std::istream& pgnStream, BoundedQueue<GameAnnotation>& output)
+    {
+        PgnReader reader(pgnStream);
+        GameAnnotation annotation;
+        while (reader.readGame(annotation.mGame))
+        {
+            output.push(std::move(annotation));
+            annotation = GameAnnotation();
+        }
+    }
+
+    void _annotatePly(const Board& board, const Move& move, TacticsScanner& scanner, PlyAnnotation& ply)
+    {
+        ply.mFen = board.fen();
+        ply.mNumLegalMoves = board.numLegalMoves();
+
+        ply.mGivesCheck = board.getAllCheckMoves().contains(move);
+
+        const Capture* capture = board.findCapture(move.fromSquare(), move.toSquare());
+        ply.mIsCapture = capture != nullptr;
+        ply.mCapturesHangingPiece = capture && capture->mCapturesHangingPiece;
+        ply.mExchangeGain = capture ? capture->mExchangeGain : Stockfish::VALUE_ZERO;
+
+        for (Stockfish::Square square = Stockfish::SQ_A1; square <= Stockfish::SQ_H8; ++square)
+        {
+            if (board.isPieceHanging(square))
+            {
+                ply.mHangingPieces |= square;
+            }
+        }
+
+        const std::vector<Fork>& forks = scanner.scan(board).mForks;
+        ply.mNumForks = forks.size();
+        ply.mPlayedFork = std::any_of(forks.begin(), forks.end(), [&move](const Fork& fork) { return fork.mMove == move; });
+    }
+
+    // walks every game through one Board, so only the moves are played and nothing is rebuilt from FEN
+    void _annotateGames(BoundedQueue<GameAnnotation>& input, BoundedQueue<GameAnnotation>& output)
+    {
+        std::optional<Board> board;
+        TacticsScanner scanner;
+        GameAnnotation annotation;
+        while (input.pop(annotation))
+        {
+            board.emplace(annotation.mGame.mFen, false);
+            for (const std::string& san : annotation.mGame.mSanMoves)
+            {
+                const std::optional<Move> move = board->findSanMove(san);
+                if (!move)
+                {
+                    annotation.mError = "no legal move " + san + " at ply " + std::to_string(annotation.mPlies.size() + 1);
+                    break;
+                }
+
+                annotation.mPlies.push_back({ *move, san, std::string(), 0, false, false, false, Stockfish::VALUE_ZERO, 0, 0, false, {}, false });
+                _annotatePly(*board, *move, scanner, annotation.mPlies.back());
+                board->applyMove(*move);
+            }
+
+            output.push(std::move(annotation));
+        }
+    }
+
+    // every position of a game is one batch, searched one position per thread
+    void _searchGames(const AnalysisLimits& limits, BoundedQueue<GameAnnotation>& input, BoundedQueue<GameAnnotation>& output)
+    {
+        BoardBatchAnalyzer analyzer(limits);
+        std::vector<std::string> fenStrings;
+        GameAnnotation annotation;
+        while (input.pop(annotation))
+        {
+            fenStrings.clear();
+            for (const PlyAnnotation& ply : annotation.mPlies)
+            {
+                fenStrings.push_back(ply.mFen);
+            }
+
+            const std::deque<Board>& boards = analyzer.analyze(fenStrings);
+            for (size_t i = 0; i < annotation.mPlies.size(); ++i)
+            {
+                PlyAnnotation& ply = annotation.mPlies[i];
+                ply.mBestMoves = boards[i].getBestMoves(limits.mMultiPV).toVector();
+                ply.mPlayedBestMove = !ply.mBestMoves.empty() && ply.mBestMoves.front() == ply.mMove;
+            }
+
+            output.push(std::move(annotation));
+        }
+    }
+
+    // runs one stage on its own thread and closes its output when it is done. If the stage throws, the exception is
+    // kept in error for analyze() to pass on, and the rest of the stage's input is still taken so the stages before it
+    // can finish too
+    template<typename Stage>
+    std::thread _startStage(Stage stage, BoundedQueue<GameAnnotation>* input, BoundedQueue<GameAnnotation>& output, std::exception_ptr& error)
+    {
+        return std::thread([stage, input, &output, &error]()
+            {
+                try
+                {
+                    stage();
+                }
+                catch (...)
+                {
+                    error = std::current_exception();
+
+                    GameAnnotation skipped;
+                    while (input && input->pop(skipped))
+                    {
+                    }
+                }
+
+                output.close();
+            });
+    }
+}
+
+std::ostream& operator<<(std::ostream& stream, const GameAnnotation& annotation)
+{
+    const PgnGame& game = annotation.mGame;
+    stream << "# " << game.tag("White") << " - " << game.tag("Black") << " " << game.mResult;
+    if (!annotation.mError.empty())
+    {
+        stream << " (" << annotation.mError << ")";
+    }
+    stream << "\n";
+
+    // ply, SAN, UCI move, legal moves, check, exchange gain of a capture, hanging pieces, forks available, best moves
+    for (size_t i = 0; i < annotation.mPlies.size(); ++i)
+    {
+        const PlyAnnotation& ply = annotation.mPlies[i];
+        stream << i + 1 << "\t" << ply.mSan << "\t" << Stockfish::UCI::move(ply.mMove.stockfishMove(), false) << "\t"
+               << ply.mNumLegalMoves << "\t" << (ply.mGivesCheck ? "check" : "-") << "\t";
+
+        if (ply.mIsCapture)
+        {
+            stream << ply.mExchangeGain << (ply.mCapturesHangingPiece ? " hanging" : "");
+        }
+        else
+        {
+            stream << "-";
+        }
+
+        stream << "\t";
+        Stockfish::Bitboard hangingPieces = ply.mHangingPieces;
+        stream << (hangingPieces ? "" : "-");
+        while (hangingPieces)
+        {
+            stream << Stockfish::UCI::square(Stockfish::pop_lsb(hangingPieces)) << (hangingPieces ? "," : "");
+        }
+
+        stream << "\t" << ply.mNumForks << (ply.mPlayedFork ? " played" : "") << "\t";
+        stream << (ply.mBestMoves.empty() ? "-" : "");
+        for (size_t j = 0; j < ply.mBestMoves.size(); ++j)
+        {
+            stream << (j ? "," : "") << Stockfish::UCI::move(ply.mBestMoves[j].stockfishMove(), false);
+        }
+        stream << "\n";
+    }
+
+    return stream;
+}
+
+double GameStatistics::gamesPerSecond() const
+{
+    if (mElapsedSeconds <= 0.0)
+    {
+        return 0.0;
+    }
+
+    return static_cast<double>(mNumGames) / mElapsedSeconds;
+}
+
+double GameStatistics::pliesPerSecond() const
+{
+    if (mElapsedSeconds <= 0.0)
+    {
+        return 0.0;
+    }
+
+    return static_cast<double>(mNumPlies) / mElapsedSeconds;
+}
+
+GamePipeline::GamePipeline(const std::optional<AnalysisLimits>& searchLimits, const size_t queueCapacity)
+    : mSearchLimits(searchLimits)
+    , mQueueCapacity(queueCapacity)
+    , mStatistics()
+{
+
+}
+
+void GamePipeline::analyze(std::istream& pgnStream, const std::function<void(const GameAnnotation&)>& onGameAnnotated)
+{
+    mStatistics = GameStatistics();
+    const auto start = std::chrono::steady_clock::now();
+
+    BoundedQueue<GameAnnotation> readGames(mQueueCapacity);
+    BoundedQueue<GameAnnotation> annotatedGames(mQueueCapacity);
+    BoundedQueue<GameAnnotation> searchedGames(mQueueCapacity);
+
+    // one per stage, in the order of the stages
+    std::array<std::exception_ptr, 3> stageErrors;
+    std::vector<std::thread> stages;
+    stages.push_back(_startStage([&pgnStream, &readGames]() { _readGames(pgnStream, readGames); },
+        nullptr, readGames, stageErrors[0]));
+    stages.push_back(_startStage([&readGames, &annotatedGames]() { _annotateGames(readGames, annotatedGames); },
+        &readGames, annotatedGames, stageErrors[1]));
+    if (mSearchLimits)
+    {
+        const AnalysisLimits& limits = *mSearchLimits;
+        stages.push_back(_startStage([&limits, &annotatedGames, &searchedGames]() { _searchGames(limits, annotatedGames, searchedGames); },
+            &annotatedGames, searchedGames, stageErrors[2]));
+    }
+
+    // the last stage is the caller. The stages before it only stop once their input is used up, so it keeps taking
+    // games even after the callback failed
+    BoundedQueue<GameAnnotation>& finishedGames = mSearchLimits ? searchedGames : annotatedGames;
+    std::exception_ptr callbackError;
+    GameAnnotation annotation;
+    while (finishedGames.pop(annotation))
+    {
+        if (callbackError)
+        {
+            continue;
+        }
+
+        ++mStatistics.mNumGames;
+        mStatistics.mNumPlies += annotation.mPlies.size();
+        try
+        {
+            onGameAnnotated(annotation);
+        }
+        catch (...)
+        {
+            callbackError = std::current_exception();
+        }
+    }
+
+    for (std::thread& stage : stages)
+    {
+        stage.join();
+    }
+
+    mStatistics.mElapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    for (const std::exception_ptr& stageError : stageErrors)
+    {
+        if (stageError)
+        {
+            std::rethrow_exception(stageError);
+        }
+    }
+    if (callbackError)
+    {
+        std::rethrow_exception(callbackError);
+    }
+}
+
+const GameStatistics& GamePipeline::statistics() const
+{
+    return mStatistics;
+}
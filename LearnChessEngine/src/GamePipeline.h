@@ -0,0 +1,78 @@
+#pragma once
+
+#include "CommonData.h"
+#include "PgnReader.h"
+
+#include <functional>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// what Board says about the position before one move of a game, and about the move played in it
+struct PlyAnnotation
+{
+    Move mMove;
+    std::string mSan; // as written in the game
+    std::string mFen;
+    size_t mNumLegalMoves;
+    bool mGivesCheck;
+    bool mIsCapture;
+    bool mCapturesHangingPiece;
+    Stockfish::Value mExchangeGain; // of the capture, VALUE_ZERO for other moves
+    Stockfish::Bitboard mHangingPieces; // of both sides
+    size_t mNumForks; // forks the side to move had, see TacticsScanner
+    bool mPlayedFork;
+
+    // empty unless the pipeline searches
+    std::vector<Move> mBestMoves;
+    bool mPlayedBestMove;
+};
+
+struct GameAnnotation
+{
+    PgnGame mGame;
+    // one per move played, up to the first move that couldn't be read or isn't legal
+    std::vector<PlyAnnotation> mPlies;
+    std::string mError; // why the game stopped early, empty if all of it was annotated
+};
+
+// one line per game with its tags and one tab separated line per ply
+std::ostream& operator<<(std::ostream& stream, const GameAnnotation& annotation);
+
+struct GameStatistics
+{
+    double gamesPerSecond() const;
+    double pliesPerSecond() const;
+
+    size_t mNumGames = 0;
+    size_t mNumPlies = 0;
+    double mElapsedSeconds = 0.0;
+};
+
+// Annotates every position of every game in a PGN file. Reading the PGN, walking a game through Board (SAN -> move ->
+// features -> applyMove) and searching run as separate stages on their own threads, handing games to each other
+// through bounded queues. A slow stage holds up the ones before it instead of letting games pile up, so memory stays
+// at a few games however large the file is, and the stages overlap instead of taking turns
+class GamePipeline
+{
+public:
+    // with searchLimits every ply is also searched, one position per search thread (see BoardBatchAnalyzer). At most
+    // queueCapacity games wait between two stages
+    explicit GamePipeline(const std::optional<AnalysisLimits>& searchLimits = std::nullopt, size_t queueCapacity = 16);
+
+    // onGameAnnotated is called on the calling thread, once per game and in the order of the file. If it throws, the
+    // rest of the file is still read (but not handed out) before the exception is passed on. A stage that throws
+    // (reading the stream, a game Board can't set up, running out of memory) ends the games after it, and its
+    // exception is passed on once the other stages are done, ahead of one from onGameAnnotated
+    void analyze(std::istream& pgnStream, const std::function<void(const GameAnnotation&)>& onGameAnnotated);
+
+    // statistics of the last call to analyze()
+    const GameStatistics& statistics() const;
+
+private:
+    std::optional<AnalysisLimits> mSearchLimits;
+    size_t mQueueCapacity;
+    GameStatistics mStatistics;
+};
@@ -0,0 +1,206 @@
+#include "PgnReader.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+    const std::string StartFen = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+    bool _isBlank(const std::string& line)
+    {
+        return line.find_first_not_of(" \t") == std::string::npos;
+    }
+
+    bool _isResult(const std::string& token)
+    {
+        return token == "1-0" || token == "0-1" || token == "1/2-1/2" || token == "*";
+    }
+}
+
+const std::string& PgnGame::tag(const std::string& name) const
+{
+    static const std::string none;
+    for (const auto& tag : mTags)
+    {
+        if (tag.first == name)
+        {
+            return tag.second;
+        }
+    }
+
+    return none;
+}
+
+PgnReader::PgnReader(std::istream& pgnStream)
+    : mPgnStream(pgnStream)
+    , mPendingLine()
+    , mHasPendingLine(false)
+    , mInComment(false)
+    , mVariationDepth(0)
+{
+
+}
+
+bool PgnReader::readGame(PgnGame& game)
+{
+    // clear() keeps the capacity, so reading game after game into the same PgnGame doesn't allocate much
+    game.mTags.clear();
+    game.mSanMoves.clear();
+    game.mResult.clear();
+    game.mFen = StartFen;
+    mInComment = false;
+    mVariationDepth = 0;
+
+    bool hasContent = false;
+    bool inMovetext = false;
+    std::string line;
+    while (_nextLine(line))
+    {
+        const size_t first = line.find_first_not_of(" \t");
+
+        // tag pairs before the movetext, a tag after it is the next game when this one had no result
+        if (!mInComment && first != std::string::npos && line[first] == '[')
+        {
+            if (inMovetext)
+            {
+                mPendingLine = line;
+                mHasPendingLine = true;
+                return true;
+            }
+
+            _readTag(line.substr(first), game);
+            hasContent = true;
+            continue;
+        }
+
+        // escaped lines are for other programs
+        if (_isBlank(line) || (!mInComment && line[0] == '%'))
+        {
+            continue;
+        }
+
+        inMovetext = true;
+        hasContent = true;
+        if (_readMovetext(line, game))
+        {
+            return true;
+        }
+    }
+
+    return hasContent;
+}
+
+bool PgnReader::_nextLine(std::string& line)
+{
+    if (mHasPendingLine)
+    {
+        line = mPendingLine;
+        mHasPendingLine = false;
+        return true;
+    }
+
+    if (!std::getline(mPgnStream, line))
+    {
+        return false;
+    }
+
+    if (!line.empty() && line.back() == '\r')
+    {
+        line.pop_back();
+    }
+    return true;
+}
+
+bool PgnReader::_readMovetext(const std::string& line, PgnGame& game)
+{
+    size_t i = 0;
+    while (i < line.size())
+    {
+        const char c = line[i];
+        if (mInComment)
+        {
+            mInComment = c != '}';
+            ++i;
+            continue;
+        }
+
+        // a ';' comment runs to the end of the line
+        if (c == ';')
+        {
+            break;
+        }
+
+        if (c == '{' || c == '}' || c == '(' || c == ')' || std::isspace(static_cast<unsigned char>(c)))
+        {
+            mInComment = c == '{';
+            mVariationDepth += c == '(' ? 1 : c == ')' && mVariationDepth ? -1 : 0;
+            ++i;
+            continue;
+        }
+
+        const size_t end = std::min(line.find_first_of(" \t{};()", i), line.size());
+        std::string token = line.substr(i, end - i);
+        i = end;
+
+        if (mVariationDepth)
+        {
+            continue;
+        }
+
+        if (_isResult(token))
+        {
+            game.mResult = token;
+            return true;
+        }
+
+        // move numbers, also written together with the move ("12.e4", "12...Nf6"), but not castling with zeros
+        const size_t numberEnd = token.find_first_not_of("0123456789");
+        if (numberEnd != std::string::npos && numberEnd > 0 && token[numberEnd] == '.')
+        {
+            token.erase(0, token.find_first_not_of("0123456789."));
+        }
+        else if (token[0] == '.')
+        {
+            token.erase(0, token.find_first_not_of('.'));
+        }
+
+        // numeric annotation glyphs
+        if (token.empty() || token[0] == '$')
+        {
+            continue;
+        }
+
+        game.mSanMoves.push_back(std::move(token));
+    }
+
+    return false;
+}
+
+void PgnReader::_readTag(const std::string& line, PgnGame& game) const
+{
+    // [Name "Value"], where the value can escape quotes and backslashes
+    const size_t nameEnd = line.find_first_of(" \t\"]", 1);
+    const size_t valueStart = line.find('"', nameEnd);
+    if (nameEnd == std::string::npos || valueStart == std::string::npos)
+    {
+        return;
+    }
+
+    std::string value;
+    for (size_t i = valueStart + 1; i < line.size() && line[i] != '"'; ++i)
+    {
+        if (line[i] == '\\' && i + 1 < line.size())
+        {
+            ++i;
+        }
+        value += line[i];
+    }
+
+    const std::string name = line.substr(1, nameEnd - 1);
+    if (name == "FEN")
+    {
+        game.mFen = value;
+    }
+    game.mTags.emplace_back(name, std::move(value));
+}
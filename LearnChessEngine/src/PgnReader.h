@@ -0,0 +1,39 @@
+#pragma once
+
+#include <istream>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct PgnGame
+{
+    // the value of a tag, empty if the game doesn't have it
+    const std::string& tag(const std::string& name) const;
+
+    std::vector<std::pair<std::string, std::string>> mTags;
+    std::string mFen; // the FEN tag, or the standard starting position
+    std::vector<std::string> mSanMoves; // main line only, comments, variations and move numbers are left out
+    std::string mResult; // "1-0", "0-1", "1/2-1/2" or "*", empty if the game text ended without one
+};
+
+// Reads the games of a PGN file one at a time, so a file of any size is read with the memory of a single game
+class PgnReader
+{
+public:
+    explicit PgnReader(std::istream& pgnStream);
+
+    // replaces game with the next one, false once there are none left
+    bool readGame(PgnGame& game);
+
+private:
+    bool _nextLine(std::string& line);
+    // adds the moves of one line of movetext to game, true once the result ends the game
+    bool _readMovetext(const std::string& line, PgnGame& game);
+    void _readTag(const std::string& line, PgnGame& game) const;
+
+    std::istream& mPgnStream;
+    std::string mPendingLine; // first line of the next game, when a game ended without a result
+    bool mHasPendingLine;
+    bool mInComment;
+    int mVariationDepth;
+};
@@ -0,0 +1,238 @@
+#include "SearchPool.h"
+
+#include "bitboard.h"
+#include "search.h"
+#include "thread.h"
+#include "tt.h"
+#include "uci.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+    // the most threads Stockfish's "Threads" option takes
+    constexpr size_t MaxThreads = 512;
+
+    // whoever needs both takes searchMutex first
+    std::mutex poolMutex;
+    SearchPoolOptions poolOptions;
+    std::mutex searchMutex;
+
+    // posted jobs, run in order by jobThread
+    std::mutex jobsMutex;
+    std::condition_variable jobsChanged;
+    std::deque<std::function<void()>> jobs;
+    std::thread jobThread;
+    bool stoppingJobs = false;
+
+    const std::string& _valueOf(const std::vector<std::string>& args, const size_t index)
+    {
+        if (index + 1 == args.size())
+        {
+            throw std::invalid_argument(args[index] + " needs a value");
+        }
+
+        return args[index + 1];
+    }
+
+    void _runJobs()
+    {
+        std::unique_lock<std::mutex> lock(jobsMutex);
+        while (true)
+        {
+            jobsChanged.wait(lock, []() { return !jobs.empty() || stoppingJobs; });
+            if (jobs.empty())
+            {
+                return;
+            }
+
+            const std::function<void()> job = std::move(jobs.front());
+            jobs.pop_front();
+
+            lock.unlock();
+            job();
+            lock.lock();
+        }
+    }
+
+    size_t _numThreads(const SearchPoolOptions& options)
+    {
+        const size_t numThreads = options.mNumThreads ? options.mNumThreads : std::thread::hardware_concurrency();
+        return std::clamp<size_t>(numThreads, 1, MaxThreads);
+    }
+
+    // the threads are started by setting "Threads", which sizes the table from "Hash" and binds by "Bind Threads",
+    // so those go first
+    void _applyOptions(const SearchPoolOptions& options)
+    {
+        const bool newThreads = Stockfish::Threads.size() != _numThreads(options);
+
+        Stockfish::Options["Bind Threads"] = options.mBindThreads;
+        Stockfish::Options["Keep Hash"] = std::string(options.mKeepHashOnResize ? "true" : "false");
+
+        // new threads clear the table they size anyway, so the running ones are stopped first and a new "Hash" isn't
+        // applied (or rehashed) to a table that is about to be replaced
+        if (newThreads)
+        {
+            Stockfish::Threads.set(0);
+        }
+
+        if (size_t(Stockfish::Options["Hash"]) != options.mHashMB)
+        {
+            Stockfish::Options["Hash"] = std::to_string(options.mHashMB);
+        }
+
+        if (newThreads)
+        {
+            Stockfish::Options["Threads"] = std::to_string(_numThreads(options));
+        }
+    }
+}
+
+SearchPoolOptions SearchPoolOptions::parse(std::vector<std::string>& args)
+{
+    SearchPoolOptions options;
+    for (size_t i = 0; i < args.size();)
+    {
+        if (args[i] == "--threads")
+        {
+            options.mNumThreads = std::stoul(_valueOf(args, i));
+        }
+        else if (args[i] == "--hash")
+        {
+            options.mHashMB = std::max<size_t>(1, std::stoul(_valueOf(args, i)));
+        }
+        else if (args[i] == "--hash-file")
+        {
+            options.mHashFile = _valueOf(args, i);
+        }
+        else if (args[i] == "--bind")
+        {
+            options.mBindThreads = _valueOf(args, i);
+            if (options.mBindThreads != "auto" && options.mBindThreads != "on" && options.mBindThreads != "off")
+            {
+                throw std::invalid_argument("--bind takes auto, on or off, not " + options.mBindThreads);
+            }
+        }
+        else
+        {
+            ++i;
+            continue;
+        }
+
+        args.erase(args.begin() + i, args.begin() + i + 2);
+    }
+
+    return options;
+}
+
+void SearchPool::configure(const SearchPoolOptions& options)
+{
+    // new threads or a resized table under a search would pull them out from under it, so no search may start meanwhile
+    const std::unique_lock<std::mutex> searchLock = lockSearch();
+    std::lock_guard<std::mutex> lock(poolMutex);
+    poolOptions = options;
+
+    if (Stockfish::Threads.size())
+    {
+        Stockfish::Threads.main()->wait_for_search_finished();
+        _applyOptions(poolOptions);
+    }
+}
+
+SearchPoolOptions SearchPool::options()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return poolOptions;
+}
+
+void SearchPool::start()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (Stockfish::Threads.size())
+    {
+        return;
+    }
+
+    // only the evaluation needs the bitbases, so they're built with the first threads instead of at startup
+    static std::once_flag bitbasesBuilt;
+    std::call_once(bitbasesBuilt, Stockfish::Bitbases::init);
+
+    _applyOptions(poolOptions);
+    Stockfish::Search::clear();
+
+    // a missing file is a first run, not a problem
+    if (!poolOptions.mHashFile.empty() && std::ifstream(poolOptions.mHashFile)
+        && !Stockfish::TT.load(poolOptions.mHashFile))
+    {
+        std::cerr << "Could not load the hash from " << poolOptions.mHashFile << ", starting with an empty one" << std::endl;
+    }
+}
+
+bool SearchPool::isStarted()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    return Stockfish::Threads.size() > 0;
+}
+
+void SearchPool::waitForSearchFinished()
+{
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (Stockfish::Threads.size())
+    {
+        Stockfish::Threads.main()->wait_for_search_finished();
+    }
+}
+
+std::unique_lock<std::mutex> SearchPool::lockSearch()
+{
+    return std::unique_lock<std::mutex>(searchMutex);
+}
+
+void SearchPool::post(std::function<void()> job)
+{
+    std::lock_guard<std::mutex> lock(jobsMutex);
+    if (!jobThread.joinable())
+    {
+        jobThread = std::thread(_runJobs);
+    }
+
+    jobs.push_back(std::move(job));
+    jobsChanged.notify_one();
+}
+
+void SearchPool::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        stoppingJobs = true;
+        jobsChanged.notify_one();
+    }
+
+    // jobs search, which takes searchMutex, so they're finished before it is taken here
+    if (jobThread.joinable())
+    {
+        jobThread.join();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(jobsMutex);
+        stoppingJobs = false;
+    }
+
+    // the table is saved and the threads stopped with no search running on them
+    const std::unique_lock<std::mutex> searchLock = lockSearch();
+    std::lock_guard<std::mutex> lock(poolMutex);
+    if (Stockfish::Threads.size() && !poolOptions.mHashFile.empty() && !Stockfish::TT.save(poolOptions.mHashFile))
+    {
+        std::cerr << "Could not save the hash to " << poolOptions.mHashFile << std::endl;
+    }
+
+    Stockfish::Threads.set(0);
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct SearchPoolOptions
+{
+    // takes "--threads N --hash MB --bind auto|on|off --hash-file path" out of args, wherever they are, and leaves everything else for
+    // the mode that runs. Throws std::invalid_argument for a missing or bad value
+    static SearchPoolOptions parse(std::vector<std::string>& args);
+
+    size_t mNumThreads = 0; // search threads, 0 for one per core
+    size_t mHashMB = 16; // size of the transposition table
+    // whether search threads are bound to NUMA nodes. "auto" binds them from 9 threads on, like Stockfish does
+    std::string mBindThreads = "auto";
+    // when set, the transposition table is loaded from this file when the pool starts and saved to it when it stops,
+    // so a restarted program doesn't search everything it already knew again. A file saved with another hash size is
+    // ignored and overwritten
+    std::string mHashFile;
+    // when set, a new hash size moves the entries of the table over to the resized one instead of clearing it. That
+    // needs the old and the new table in memory at once until it is done
+    bool mKeepHashOnResize = false;
+};
+
+// Owns the start of Stockfish's search threads and transposition table. They are only started the first time
+// something searches, so runs that only query boards start in milliseconds instead of waiting for the threads and
+// hash to be allocated and cleared, and runs that do search get one thread per core by default.
+//
+// Like the engine itself, the pool is shared by the whole program
+class SearchPool
+{
+public:
+    // applies right away if the pool is running, otherwise once it starts. A new hash size clears the table unless
+    // mKeepHashOnResize is set, a new number of threads always clears it
+    static void configure(const SearchPoolOptions& options);
+    static SearchPoolOptions options();
+
+    // starts the threads with a cleared transposition table and histories, unless they're already running. Whatever
+    // searches calls this first
+    static void start();
+    static bool isStarted();
+    // blocks until a running search is done, returns right away if the pool isn't started
+    static void waitForSearchFinished();
+    // held for the length of every search, so searches started from several threads take turns on the pool instead of
+    // interfering with each other. configure() and stop() hold it too, so they never change the pool under a search
+    static std::unique_lock<std::mutex> lockSearch();
+
+    // runs job on the pool's own thread once the jobs posted before it are done, for searches that shouldn't block
+    // whoever asked for them. Jobs must not throw
+    static void post(std::function<void()> job);
+
+    // runs what is still posted, waits for a running search, saves the hash file (if any) and stops the threads. The
+    // next search starts them again
+    static void stop();
+};
@@ -0,0 +1,233 @@
+#include "TacticsScanner.h"
+
+#include <algorithm>
+
+namespace
+{
+    // the king can't be traded, so it is worth more than whatever attacks it
+    int _pieceValue(const Stockfish::Position& position, const Stockfish::Square square)
+    {
+        const Stockfish::PieceType pieceType = Stockfish::type_of(position.piece_on(square));
+        return pieceType == Stockfish::KING ? Stockfish::VALUE_INFINITE : Stockfish::PieceValue[Stockfish::MG][pieceType];
+    }
+
+    // occupied is the board after the attacking move and defenders the opponent pieces still on it, so a piece that was
+    // just captured doesn't defend anything
+    bool _isWorthAttacking(const Stockfish::Position& position, const Stockfish::Square target, const int attackerValue, const Stockfish::Bitboard occupied, const Stockfish::Bitboard defenders)
+    {
+        return _pieceValue(position, target) > attackerValue
+            || !(position.attackers_to(target, occupied) & defenders & ~Stockfish::square_bb(target));
+    }
+
+    Stockfish::Bitboard _piecesWorthAttacking(const Stockfish::Position& position, Stockfish::Bitboard targets, const int attackerValue, const Stockfish::Bitboard occupied, const Stockfish::Bitboard defenders)
+    {
+        Stockfish::Bitboard worthAttacking = 0;
+        while (targets)
+        {
+            const Stockfish::Square target = Stockfish::pop_lsb(targets);
+            if (_isWorthAttacking(position, target, attackerValue, occupied, defenders))
+            {
+                worthAttacking |= target;
+            }
+        }
+
+        return worthAttacking;
+    }
+
+    Stockfish::Bitboard _attacksFrom(const Stockfish::PieceType pieceType, const Stockfish::Color colour, const Stockfish::Square square, const Stockfish::Bitboard occupied)
+    {
+        return pieceType == Stockfish::PAWN
+            ? Stockfish::pawn_attacks_bb(colour, square)
+            : Stockfish::attacks_bb(pieceType, square, occupied);
+    }
+
+    bool _isSlider(const Stockfish::PieceType pieceType)
+    {
+        return pieceType == Stockfish::BISHOP || pieceType == Stockfish::ROOK || pieceType == Stockfish::QUEEN;
+    }
+}
+
+const Tactics& TacticsScanner::scan(const Board& board)
+{
+    mTactics.mForks.clear();
+    mTactics.mSkewers.clear();
+    mTactics.mDiscoveredAttacks.clear();
+    mTactics.mOverloadedDefenders.clear();
+
+    _findForksAndSkewers(board);
+    _findDiscoveredAttacks(board);
+    _findOverloadedDefenders(board.mRawBoard);
+
+    return mTactics;
+}
+
+void TacticsScanner::_findForksAndSkewers(const Board& board)
+{
+    const Stockfish::Position& position = board.mRawBoard;
+    const Stockfish::Color sideToMove = position.side_to_move();
+
+    const Move* const movesEnd = board._sideToMoveEnd();
+    for (const Move* move = board._sideToMoveBegin(); move != movesEnd; ++move)
+    {
+        const Stockfish::MoveType moveType = move->typeOfMove();
+        if (moveType == Stockfish::CASTLING)
+        {
+            continue;
+        }
+
+        const Stockfish::Square from = move->fromSquare();
+        const Stockfish::Square to = move->toSquare();
+        const Stockfish::PieceType movedPiece = moveType == Stockfish::PROMOTION ? move->promotionType() : Stockfish::type_of(position.piece_on(from));
+
+        Stockfish::Bitboard occupied = (position.pieces() ^ from) | to;
+        if (moveType == Stockfish::EN_PASSANT)
+        {
+            occupied ^= to - Stockfish::pawn_push(sideToMove);
+        }
+        const Stockfish::Bitboard opponentPieces = position.pieces(~sideToMove) & occupied & ~Stockfish::square_bb(to);
+        const Stockfish::Bitboard attacks = _attacksFrom(movedPiece, sideToMove, to, occupied);
+        const Stockfish::Bitboard attackedPieces = attacks & opponentPieces;
+        const int movedValue = Stockfish::PieceValue[Stockfish::MG][movedPiece];
+
+        const Stockfish::Bitboard forkedPieces = Stockfish::more_than_one(attackedPieces)
+            ? _piecesWorthAttacking(position, attackedPieces, movedValue, occupied, opponentPieces)
+            : 0;
+        // a skewer needs another opponent piece right behind an attacked one
+        const bool maySkewer = _isSlider(movedPiece)
+            && (Stockfish::attacks_bb(movedPiece, to, occupied ^ attackedPieces) & ~attacks & opponentPieces);
+
+        // the exchange on the square is the expensive part, so it comes last
+        if ((!Stockfish::more_than_one(forkedPieces) && !maySkewer) || !position.see_ge(move->stockfishMove()))
+        {
+            continue;
+        }
+
+        if (Stockfish::more_than_one(forkedPieces))
+        {
+            mTactics.mForks.push_back({ *move, forkedPieces });
+        }
+
+        if (maySkewer)
+        {
+            _findSkewers(position, move->stockfishMove(), movedPiece, occupied);
+        }
+    }
+}
+
+void TacticsScanner::_findSkewers(const Stockfish::Position& position, const Stockfish::Move move, const Stockfish::PieceType movedPiece, const Stockfish::Bitboard occupied)
+{
+    const Stockfish::Square to = Stockfish::to_sq(move);
+    const Stockfish::Bitboard opponentPieces = position.pieces(~position.side_to_move()) & occupied & ~Stockfish::square_bb(to);
+    const Stockfish::Bitboard attacks = Stockfish::attacks_bb(movedPiece, to, occupied);
+    const int sliderValue = Stockfish::PieceValue[Stockfish::MG][movedPiece];
+
+    Stockfish::Bitboard frontPieces = attacks & opponentPieces;
+    while (frontPieces)
+    {
+        const Stockfish::Square front = Stockfish::pop_lsb(frontPieces);
+        if (!_isWorthAttacking(position, front, sliderValue, occupied, opponentPieces))
+        {
+            continue;
+        }
+
+        // without the front piece only its own ray gets longer, up to the next piece on it
+        const Stockfish::Bitboard behind = Stockfish::attacks_bb(movedPiece, to, occupied ^ front) & ~attacks & opponentPieces;
+        if (!behind)
+        {
+            continue;
+        }
+
+        const Stockfish::Square back = Stockfish::lsb(behind);
+        if (_pieceValue(position, front) > _pieceValue(position, back)
+            && _isWorthAttacking(position, back, sliderValue, occupied ^ front, opponentPieces ^ front))
+        {
+            mTactics.mSkewers.push_back({ Move(move), front, back });
+        }
+    }
+}
+
+void TacticsScanner::_findDiscoveredAttacks(const Board& board)
+{
+    const Stockfish::Position& position = board.mRawBoard;
+    const Stockfish::Color sideToMove = position.side_to_move();
+    const Stockfish::Bitboard occupied = position.pieces();
+
+    Stockfish::Bitboard targets = position.pieces(~sideToMove);
+    while (targets)
+    {
+        const Stockfish::Square target = Stockfish::pop_lsb(targets);
+
+        // our sliders that would attack the target on an empty board, the same x-ray Position uses for pins
+        Stockfish::Bitboard snipers = ((Stockfish::attacks_bb<Stockfish::ROOK>(target) & position.pieces(Stockfish::QUEEN, Stockfish::ROOK))
+            | (Stockfish::attacks_bb<Stockfish::BISHOP>(target) & position.pieces(Stockfish::QUEEN, Stockfish::BISHOP))) & position.pieces(sideToMove);
+
+        while (snipers)
+        {
+            const Stockfish::Square slider = Stockfish::pop_lsb(snipers);
+            const Stockfish::Bitboard blockers = (Stockfish::between_bb(slider, target) & occupied) ^ target;
+            if (!blockers || Stockfish::more_than_one(blockers) || !(blockers & position.pieces(sideToMove)))
+            {
+                continue;
+            }
+
+            const Stockfish::Square blocker = Stockfish::lsb(blockers);
+            const int sliderValue = _pieceValue(position, slider);
+            if (!_isWorthAttacking(position, target, sliderValue, occupied ^ blocker, position.pieces(~sideToMove)))
+            {
+                continue;
+            }
+
+            // moving along the line keeps it blocked
+            const Stockfish::Bitboard line = Stockfish::line_bb(slider, target);
+            const bool canLeaveLine = std::any_of(board._movesBegin(blocker), board._movesEnd(blocker), [line](const Move move)
+                {
+                    return !(line & move.toSquare());
+                });
+
+            if (canLeaveLine)
+            {
+                mTactics.mDiscoveredAttacks.push_back({ blocker, slider, target });
+            }
+        }
+    }
+}
+
+void TacticsScanner::_findOverloadedDefenders(const Stockfish::Position& position)
+{
+    const Stockfish::Color sideToMove = position.side_to_move();
+    const Stockfish::Color defendingColour = ~sideToMove;
+
+    // every attacked piece with a single defender is added to that defender's entry, entries defending fewer than two
+    // are dropped at the end
+    Stockfish::Bitboard attackedPieces = position.pieces(defendingColour) ^ position.pieces(defendingColour, Stockfish::KING);
+    while (attackedPieces)
+    {
+        const Stockfish::Square square = Stockfish::pop_lsb(attackedPieces);
+        const Stockfish::Bitboard attackers = position.attackers_to(square);
+        const Stockfish::Bitboard defenders = attackers & position.pieces(defendingColour);
+        if (!(attackers & position.pieces(sideToMove)) || !defenders || Stockfish::more_than_one(defenders))
+        {
+            continue;
+        }
+
+        const Stockfish::Square defender = Stockfish::lsb(defenders);
+        const auto entry = std::find_if(mTactics.mOverloadedDefenders.begin(), mTactics.mOverloadedDefenders.end(), [defender](const OverloadedDefender& overloaded)
+            {
+                return overloaded.mDefender == defender;
+            });
+
+        if (entry == mTactics.mOverloadedDefenders.end())
+        {
+            mTactics.mOverloadedDefenders.push_back({ defender, Stockfish::square_bb(square) });
+        }
+        else
+        {
+            entry->mDefendedPieces |= square;
+        }
+    }
+
+    mTactics.mOverloadedDefenders.erase(std::remove_if(mTactics.mOverloadedDefenders.begin(), mTactics.mOverloadedDefenders.end(), [](const OverloadedDefender& overloaded)
+        {
+            return !Stockfish::more_than_one(overloaded.mDefendedPieces);
+        }), mTactics.mOverloadedDefenders.end());
+}
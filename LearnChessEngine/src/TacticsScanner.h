@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Board.h"
+#include "CommonData.h"
+
+// Finds forks, skewers, discovered attacks and overloaded defenders for the side to move of a Board without any
+// search, only from attack bitboards and the pins Position already keeps, so whole puzzle corpora can be filtered
+// before they are analyzed.
+//
+// A piece is worth attacking when it is the king, is worth more than the attacker or isn't defended. Forks and skewers
+// are moves after which the moved piece can't be won by the opponent (Position::see_ge()). Discovered attacks and
+// overloaded defenders describe the position as it is
+class TacticsScanner
+{
+public:
+    // the result is kept in the scanner and overwritten by the next scan, so scanning many boards doesn't allocate
+    const Tactics& scan(const Board& board);
+
+private:
+    void _findForksAndSkewers(const Board& board);
+    void _findSkewers(const Stockfish::Position& position, Stockfish::Move move, Stockfish::PieceType movedPiece, Stockfish::Bitboard occupied);
+    void _findDiscoveredAttacks(const Board& board);
+    void _findOverloadedDefenders(const Stockfish::Position& position);
+
+    Tactics mTactics;
+};
@@ -0,0 +1,248 @@
+#include "TestRunner.h"
+
+#include "search.h"
+#include "thread.h"
+
+#include "SearchPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+namespace
+{
+    size_t _perCore(const size_t count)
+    {
+        return count ? count : std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    const std::string& _valueOf(const std::vector<std::string>& args, size_t& index)
+    {
+        if (++index == args.size())
+        {
+            throw std::invalid_argument(args[index - 1] + " needs a value");
+        }
+
+        return args[index];
+    }
+}
+
+TestRunnerOptions TestRunnerOptions::parse(const std::vector<std::string>& args)
+{
+    TestRunnerOptions options;
+    for (size_t i = 0; i < args.size(); ++i)
+    {
+        if (args[i] == "--jobs")
+        {
+            options.mNumJobs = std::stoul(_valueOf(args, i));
+        }
+        else if (args[i] == "--repeat")
+        {
+            options.mNumRepeats = std::max<size_t>(1, std::stoul(_valueOf(args, i)));
+        }
+        else if (args[i] == "--search-threads")
+        {
+            options.mNumSearchThreads = std::stoul(_valueOf(args, i));
+        }
+        else if (args[i] == "--baseline")
+        {
+            options.mBaselineFile = _valueOf(args, i);
+        }
+        else if (args[i] == "--update-baseline")
+        {
+            options.mUpdateBaseline = true;
+        }
+        else if (args[i] == "--tolerance")
+        {
+            options.mTolerance = std::stod(_valueOf(args, i));
+        }
+        else
+        {
+            throw std::invalid_argument("unknown test option " + args[i]);
+        }
+    }
+
+    return options;
+}
+
+TestRunner::TestRunner(const TestRunnerOptions& options)
+    : mOptions(options)
+    , mCases()
+{
+
+}
+
+void TestRunner::add(const std::string& name, const std::function<void()>& testCase, const bool usesEngine)
+{
+    mCases.push_back({ name, testCase, usesEngine, std::string(), 0.0 });
+}
+
+size_t TestRunner::run()
+{
+    std::vector<Case*> parallelCases;
+    std::vector<Case*> engineCases;
+    for (Case& testCase : mCases)
+    {
+        (testCase.mUsesEngine ? engineCases : parallelCases).push_back(&testCase);
+    }
+
+    // the search prints its progress, which would be interleaved with the report
+    std::cout.setstate(std::ios::failbit);
+    const auto start = std::chrono::steady_clock::now();
+
+    _runInParallel(parallelCases);
+
+    if (!engineCases.empty())
+    {
+        // the threads of the search pool options are used, unless the tests ask for a number of their own
+        if (mOptions.mNumSearchThreads)
+        {
+            SearchPoolOptions poolOptions = SearchPool::options();
+            poolOptions.mNumThreads = mOptions.mNumSearchThreads;
+            SearchPool::configure(poolOptions);
+        }
+        SearchPool::start();
+        Stockfish::Search::clear();
+
+        for (Case* testCase : engineCases)
+        {
+            _runCase(*testCase, 1);
+        }
+    }
+
+    const double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout.clear();
+
+    const std::map<std::string, double> baseline = _readBaseline();
+    size_t numFailed = 0;
+    size_t numSlower = 0;
+    for (const Case& testCase : mCases)
+    {
+        const auto baselineEntry = baseline.find(testCase.mName);
+        const bool isSlower = baselineEntry != baseline.end() && testCase.mSeconds > baselineEntry->second * mOptions.mTolerance;
+        numFailed += !testCase.mFailure.empty();
+        numSlower += isSlower;
+
+        std::cout << (!testCase.mFailure.empty() ? "[FAIL] " : isSlower ? "[SLOW] " : "[ OK ] ")
+                  << std::left << std::setw(28) << testCase.mName << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(12) << testCase.mSeconds * 1e3 << " ms";
+        if (baselineEntry != baseline.end())
+        {
+            std::cout << "  (baseline " << baselineEntry->second * 1e3 << " ms, x" << std::setprecision(2)
+                      << testCase.mSeconds / baselineEntry->second << ")";
+        }
+        std::cout << std::endl;
+
+        if (!testCase.mFailure.empty())
+        {
+            std::cout << "       " << testCase.mFailure << std::endl;
+        }
+    }
+
+    std::cout << mCases.size() - numFailed << "/" << mCases.size() << " passed, " << numSlower << " slower than "
+              << mOptions.mTolerance << "x their baseline, " << std::setprecision(3) << elapsedSeconds << " s" << std::endl;
+    if (baseline.empty() && !mOptions.mUpdateBaseline)
+    {
+        std::cout << "No baseline in " << mOptions.mBaselineFile << ", --update-baseline writes one" << std::endl;
+    }
+
+    if (mOptions.mUpdateBaseline)
+    {
+        _writeBaseline();
+    }
+
+    return numFailed;
+}
+
+void TestRunner::fail(const char* condition, const char* file, const int line)
+{
+    throw TestFailure(std::string(file) + ":" + std::to_string(line) + ": CHECK(" + condition + ") failed");
+}
+
+void TestRunner::_runCase(Case& testCase, const size_t numRepeats) const
+{
+    testCase.mSeconds = 0.0;
+    for (size_t i = 0; i < numRepeats && testCase.mFailure.empty(); ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        try
+        {
+            testCase.mFunction();
+        }
+        catch (const std::exception& exception)
+        {
+            testCase.mFailure = exception.what();
+        }
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        testCase.mSeconds = i ? std::min(testCase.mSeconds, seconds) : seconds;
+    }
+}
+
+void TestRunner::_runInParallel(const std::vector<Case*>& cases) const
+{
+    // workers take the next case until none are left
+    std::atomic<size_t> nextCase(0);
+    const auto work = [this, &cases, &nextCase]()
+        {
+            for (size_t i = nextCase++; i < cases.size(); i = nextCase++)
+            {
+                _runCase(*cases[i], mOptions.mNumRepeats);
+            }
+        };
+
+    std::vector<std::thread> workers;
+    const size_t numWorkers = std::min(_perCore(mOptions.mNumJobs), cases.size());
+    for (size_t i = 1; i < numWorkers; ++i)
+    {
+        workers.emplace_back(work);
+    }
+
+    work();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+std::map<std::string, double> TestRunner::_readBaseline() const
+{
+    // one "name seconds" line per case
+    std::map<std::string, double> baseline;
+    std::ifstream file(mOptions.mBaselineFile);
+
+    std::string name;
+    double seconds;
+    while (file >> name >> seconds)
+    {
+        if (seconds > 0.0)
+        {
+            baseline[name] = seconds;
+        }
+    }
+
+    return baseline;
+}
+
+void TestRunner::_writeBaseline() const
+{
+    std::ofstream file(mOptions.mBaselineFile);
+    file << std::setprecision(9);
+    for (const Case& testCase : mCases)
+    {
+        if (testCase.mFailure.empty())
+        {
+            file << testCase.mName << " " << testCase.mSeconds << "\n";
+        }
+    }
+
+    if (!file)
+    {
+        std::cerr << "Could not write the test baseline to " << mOptions.mBaselineFile << std::endl;
+    }
+}
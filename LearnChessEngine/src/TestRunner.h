@@ -0,0 +1,72 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// thrown by CHECK, ends the test case it fails in
+class TestFailure : public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// unlike assert this stays in release builds, so the tests also run against the optimized binary. Must be used on the
+// thread running the test case, not in callbacks the engine calls from its own threads
+#define CHECK(condition) ((condition) ? static_cast<void>(0) : TestRunner::fail(#condition, __FILE__, __LINE__))
+
+struct TestRunnerOptions
+{
+    // reads "--jobs N --repeat N --search-threads N --baseline FILE --update-baseline --tolerance X", throws
+    // std::invalid_argument for anything else
+    static TestRunnerOptions parse(const std::vector<std::string>& args);
+
+    size_t mNumJobs = 0; // cases run at once, 0 for one per core
+    size_t mNumRepeats = 5; // every case that doesn't search is timed this often and the fastest run counts
+    // 0 for the threads of the search pool (one per core unless --threads says otherwise), only started once the first
+    // searching case runs
+    size_t mNumSearchThreads = 0;
+    std::string mBaselineFile = "TestBaseline.txt";
+    bool mUpdateBaseline = false; // writes this run's times to the baseline file
+    double mTolerance = 1.5; // a case is flagged when it takes this many times as long as its baseline
+};
+
+// Runs test cases and reports every case's result and wall time, comparing the times against the ones stored in a
+// baseline file so slowdowns show up next to failures.
+//
+// Cases that don't touch the engine run in parallel. Cases that search share Stockfish's global thread pool and
+// transposition table, so they run one after the other once the others are done, and only once each since a second
+// search would find the first one's results
+class TestRunner
+{
+public:
+    explicit TestRunner(const TestRunnerOptions& options);
+
+    void add(const std::string& name, const std::function<void()>& testCase, bool usesEngine = false);
+
+    // prints the report to std::cout and returns the number of failed cases
+    size_t run();
+
+    [[noreturn]] static void fail(const char* condition, const char* file, int line);
+
+private:
+    struct Case
+    {
+        std::string mName;
+        std::function<void()> mFunction;
+        bool mUsesEngine;
+
+        std::string mFailure; // empty when the case passed
+        double mSeconds;
+    };
+
+    void _runCase(Case& testCase, size_t numRepeats) const;
+    void _runInParallel(const std::vector<Case*>& cases) const;
+    std::map<std::string, double> _readBaseline() const;
+    void _writeBaseline() const;
+
+    TestRunnerOptions mOptions;
+    std::vector<Case> mCases;
+};
@@ -2,8 +2,28 @@
 
 #include "position.h"
 #include "thread.h"
+#include "tt.h"
+#include "uci.h"
 
+#include "AnalysisCache.h"
+#include "AnalysisSession.h"
 #include "Board.h"
+#include "BoardBatchAnalyzer.h"
+#include "BoardCache.h"
+#include "FeatureExporter.h"
+#include "GamePipeline.h"
+#include "SearchPool.h"
+#include "TacticsScanner.h"
+#include "TestRunner.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
 
 namespace 
 {
@@ -21,7 +41,7 @@ void _legalMovesOfPawn()
 
         const size_t numMoves = board.numLegalMovesOfPiece(Stockfish::Square::SQ_E2);
 
-        assert(numMoves == 2);
+        CHECK(numMoves == 2);
     }
 
     // pawn hasnt moved black
@@ -30,7 +50,7 @@ void _legalMovesOfPawn()
 
         const size_t numMoves = board.numLegalMovesOfPiece(Stockfish::Square::SQ_E7);
 
-        assert(numMoves == 2);
+        CHECK(numMoves == 2);
     }
 
     // pawn has moved white
@@ -39,7 +59,7 @@ void _legalMovesOfPawn()
 
         const size_t numMoves = board.numLegalMovesOfPiece(Stockfish::Square::SQ_E3);
 
-        assert(numMoves == 1);
+        CHECK(numMoves == 1);
     }
 
     // pawn has moved black
@@ -48,7 +68,7 @@ void _legalMovesOfPawn()
 
         const size_t numMoves = board.numLegalMovesOfPiece(Stockfish::Square::SQ_E6);
 
-        assert(numMoves == 1);
+        CHECK(numMoves == 1);
     }
 }
 
@@ -61,8 +81,8 @@ void _legalMovesPinned()
         const size_t numMoves = board.numLegalMovesOfPiece(Stockfish::Square::SQ_D2);
         const bool isPiecePinned = board.isPiecePinned(Stockfish::Square::SQ_D2);
 
-        assert(numMoves == 0);
-        assert(isPiecePinned);
+        CHECK(numMoves == 0);
+        CHECK(isPiecePinned);
     }
 
     // knight pinned by queen diagonally
@@ -72,8 +92,8 @@ void _legalMovesPinned()
         const size_t numMoves = board.numLegalMovesOfPiece(Stockfish::Square::SQ_C3);
         const bool isPiecePinned = board.isPiecePinned(Stockfish::Square::SQ_C3);
 
-        assert(numMoves == 0);
-        assert(isPiecePinned);
+        CHECK(numMoves == 0);
+        CHECK(isPiecePinned);
     }
 
     // bishop pinned by queen
@@ -83,8 +103,8 @@ void _legalMovesPinned()
         const size_t numMoves = board.numLegalMovesOfPiece(Stockfish::Square::SQ_D2);
         const bool isPiecePinned = board.isPiecePinned(Stockfish::Square::SQ_D2);
 
-        assert(numMoves == 3);
-        assert(isPiecePinned);
+        CHECK(numMoves == 3);
+        CHECK(isPiecePinned);
     }
 
     // queen pinned by queen
@@ -94,8 +114,8 @@ void _legalMovesPinned()
         const size_t numMoves = board.numLegalMovesOfPiece(Stockfish::Square::SQ_D2);
         const bool isPiecePinned = board.isPiecePinned(Stockfish::Square::SQ_D2);
 
-        assert(numMoves == 3);
-        assert(isPiecePinned);
+        CHECK(numMoves == 3);
+        CHECK(isPiecePinned);
     }
 
     // knight pinned by queen straight
@@ -105,8 +125,8 @@ void _legalMovesPinned()
         const size_t numMoves = board.numLegalMovesOfPiece(Stockfish::Square::SQ_E5);
         const bool isPiecePinned = board.isPiecePinned(Stockfish::Square::SQ_E5);
 
-        assert(numMoves == 0);
-        assert(isPiecePinned);
+        CHECK(numMoves == 0);
+        CHECK(isPiecePinned);
     }
 
     // knight pinned by bishop. Bishop can only take knight that is pinned
@@ -117,16 +137,76 @@ void _legalMovesPinned()
         const bool isPiecePinned = board.isPiecePinned(Stockfish::Square::SQ_C3);
         const size_t numMovesOfTakenPiece = board.numLegalMovesForPiecesThePieceCanCapture(Stockfish::Square::SQ_B4); 
 
-        assert(numMoves == 0);
-        assert(isPiecePinned);
-        assert(numMovesOfTakenPiece == 0);
+        CHECK(numMoves == 0);
+        CHECK(isPiecePinned);
+        CHECK(numMovesOfTakenPiece == 0);
     }
 }
 
+void _legalMovesOfOpponent()
+{
+    // pawns of the side that isn't to move, including the double push and promotions
+    {
+        const Board board = _setupBoard("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1");
+
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_D2) == 2);
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_G1) == 3);
+    }
+
+    {
+        const Board board = _setupBoard("8/1P6/8/8/8/8/k7/4K3 b - - 0 1");
+
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_B7) == 4);
+    }
+
+    // castling of the side that isn't to move, only through squares that aren't attacked
+    {
+        const Board board = _setupBoard("r3k2r/8/8/8/8/8/8/R3KR2 w Qkq - 0 1");
+
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_E8) == 4);
+    }
+
+    // the side to move is in check
+    {
+        const Board board = _setupBoard("8/2p4P/8/kr6/6R1/8/8/1K6 w - - 0 1");
+
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_A5) == 2);
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_B5) == 12);
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_G4) == 1);
+        CHECK(!board.isPieceHanging(Stockfish::Square::SQ_B5));
+    }
+}
+
+void _moveSpans()
+{
+    // moves decode the same way Stockfish does
+    constexpr Move promotion(Stockfish::make<Stockfish::PROMOTION>(Stockfish::Square::SQ_B7, Stockfish::Square::SQ_A8, Stockfish::PieceType::ROOK));
+    static_assert(promotion.fromSquare() == Stockfish::Square::SQ_B7 && promotion.toSquare() == Stockfish::Square::SQ_A8);
+    static_assert(promotion.typeOfMove() == Stockfish::MoveType::PROMOTION && promotion.promotionType() == Stockfish::PieceType::ROOK);
+    static_assert(Move() == Move(Stockfish::MOVE_NONE));
+
+    // the spans point into the board, grouped by piece
+    const Board board = _setupBoard("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    const MoveSpan legalMoves = board.getLegalMoves();
+    const MoveSpan knightMoves = board.getLegalMovesOfPiece(Stockfish::Square::SQ_G1);
+
+    CHECK(legalMoves.size() == 20);
+    CHECK(knightMoves.size() == 2);
+    CHECK(knightMoves.begin() >= legalMoves.begin() && knightMoves.end() <= legalMoves.end());
+    CHECK(knightMoves[0].fromSquare() == Stockfish::Square::SQ_G1 && knightMoves[1].fromSquare() == Stockfish::Square::SQ_G1);
+    CHECK(board.getLegalMovesOfPiece(Stockfish::Square::SQ_G8).size() == 2);
+    CHECK(board.getLegalMovesOfPiece(Stockfish::Square::SQ_E4).empty());
+
+    // asking again doesn't build the list again
+    CHECK(board.getAllCaptures().empty());
+    CHECK(board.getAllCheckMoves().begin() == board.getAllCheckMoves().begin());
+}
+
 void _countLegalMoves()
 {
     _legalMovesOfPawn();
     _legalMovesPinned();
+    _legalMovesOfOpponent();
 }
 
 void _captures()
@@ -137,7 +217,7 @@ void _captures()
 
         const size_t numMoves = board.numCapturesPossibleFromPiece(Stockfish::Square::SQ_E5);
 
-        assert(numMoves == 1);
+        CHECK(numMoves == 1);
     }
 
     // contrived example where a knight can take 8 different pawns
@@ -146,7 +226,7 @@ void _captures()
 
         const size_t numMoves = board.numCapturesPossibleFromPiece(Stockfish::Square::SQ_D4);
 
-        assert(numMoves == 8);
+        CHECK(numMoves == 8);
     }
 
     // king is the only protection, but there are 2 attackers
@@ -155,7 +235,7 @@ void _captures()
 
         const bool moveCapturesHangingPiece = board.moveCapturesHangingPiece(Stockfish::Square::SQ_D5, Stockfish::Square::SQ_E4);
 
-        assert(moveCapturesHangingPiece);
+        CHECK(moveCapturesHangingPiece);
     }
 }
 
@@ -168,8 +248,8 @@ void _hanging()
         const bool isHanging = board.isPieceHanging(Stockfish::Square::SQ_D5);
         const bool moveCapturesHangingPiece = board.moveCapturesHangingPiece(Stockfish::Square::SQ_E4, Stockfish::Square::SQ_D5);
 
-        assert(!isHanging);
-        assert(!moveCapturesHangingPiece);
+        CHECK(!isHanging);
+        CHECK(!moveCapturesHangingPiece);
     }
 
     // simple pawn takes pawn
@@ -179,8 +259,8 @@ void _hanging()
         const bool isHanging = board.isPieceHanging(Stockfish::Square::SQ_E4);
         const bool moveCapturesHangingPiece = board.moveCapturesHangingPiece(Stockfish::Square::SQ_D5, Stockfish::Square::SQ_E4);
 
-        assert(isHanging);
-        assert(moveCapturesHangingPiece);
+        CHECK(isHanging);
+        CHECK(moveCapturesHangingPiece);
     }
 
     // pinned piece is the only protection
@@ -189,7 +269,7 @@ void _hanging()
 
         const bool isHanging = board.isPieceHanging(Stockfish::Square::SQ_E4);
 
-        assert(isHanging);
+        CHECK(isHanging);
     }
 
     // king is the only protection, and there is only 1 attacker
@@ -199,8 +279,8 @@ void _hanging()
         const bool isHanging = board.isPieceHanging(Stockfish::Square::SQ_E4);
         const bool moveCapturesHangingPiece = board.moveCapturesHangingPiece(Stockfish::Square::SQ_D5, Stockfish::Square::SQ_E4);
 
-        assert(!isHanging);
-        assert(!moveCapturesHangingPiece);
+        CHECK(!isHanging);
+        CHECK(!moveCapturesHangingPiece);
     }
 
     // king is the only protection, but there are 2 attackers
@@ -210,8 +290,8 @@ void _hanging()
         const bool isHanging = board.isPieceHanging(Stockfish::Square::SQ_E4);
         const bool moveCapturesHangingPiece = board.moveCapturesHangingPiece(Stockfish::Square::SQ_D5, Stockfish::Square::SQ_E4);
 
-        assert(isHanging);
-        assert(moveCapturesHangingPiece);
+        CHECK(isHanging);
+        CHECK(moveCapturesHangingPiece);
     }
 }
 
@@ -222,44 +302,1153 @@ void _getBestMove()
     const Board board = _setupBoard("rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1", true);
 
     const bool isHanging = board.isPieceHanging(Stockfish::Square::SQ_H5);
-    const std::vector<Move> bestMoves = board.getBestMoves(5);
+    const MoveSpan bestMoves = board.getBestMoves(5);
 
-    assert(isHanging);
-    assert(bestMoves.size() == 5);
-    assert(bestMoves[0].mFromSquare == Stockfish::Square::SQ_F6);
-    assert(bestMoves[1].mFromSquare == Stockfish::Square::SQ_G6);
+    CHECK(isHanging);
+    CHECK(bestMoves.size() == 5);
+    CHECK(bestMoves[0].fromSquare() == Stockfish::Square::SQ_F6);
+    CHECK(bestMoves[1].fromSquare() == Stockfish::Square::SQ_G6);
+}
+
+void _streamBestMoves()
+{
+    // the best moves are streamed after every depth, and the last list is what the board keeps
+    AnalysisLimits limits;
+    limits.mDepth = 6;
+    limits.mMultiPV = 3;
+
+    // the callback runs on the search thread, so it only records what it was given
+    std::vector<int> depths;
+    std::vector<size_t> numStreamedMoves;
+    std::vector<Move> lastBestMoves;
+    const int multiPVOption = int(Stockfish::Options["MultiPV"]);
+    const Board board("rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1", limits, [&](const MoveSpan bestMoves, const int depth)
+        {
+            numStreamedMoves.push_back(bestMoves.size());
+            depths.push_back(depth);
+            lastBestMoves = bestMoves.toVector();
+        });
+
+    const MoveSpan bestMoves = board.getBestMoves(3);
+
+    CHECK(std::all_of(numStreamedMoves.begin(), numStreamedMoves.end(), [](const size_t numMoves) { return numMoves == 3; }));
+    CHECK(depths.size() == 6);
+    CHECK(depths.front() == 1 && depths.back() == 6);
+    CHECK(bestMoves.size() == 3);
+    // the limits' MultiPV is the search's own, the option is left alone
+    CHECK(int(Stockfish::Options["MultiPV"]) == multiPVOption);
+    for (size_t i = 0; i < bestMoves.size(); ++i)
+    {
+        CHECK(bestMoves[i].stockfishMove() == lastBestMoves[i].stockfishMove());
+    }
+}
+
+void _invalidAnalysisLimits()
+{
+    // limits that would never stop the search, or that ask for no moves, are refused instead of hanging
+    AnalysisLimits noLimit;
+    noLimit.mDepth = 0;
+    AnalysisLimits noPrincipalVariation;
+    noPrincipalVariation.mMultiPV = 0;
+
+    Board board("rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1", false);
+    for (const AnalysisLimits& limits : { noLimit, noPrincipalVariation })
+    {
+        bool threw = false;
+        try
+        {
+            board.analyze(limits);
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        CHECK(threw);
+
+        threw = false;
+        try
+        {
+            board.analyzeAsync(limits).get();
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+
+    // the board still searches with proper limits afterwards
+    AnalysisLimits limits;
+    limits.mDepth = 4;
+    board.analyze(limits);
+    CHECK(board.getBestMoves(5).size() == 5);
 }
 
 void _checksAndCaptures()
 {
     const Board board = _setupBoard("rn1qkbnr/1ppbppp1/p6p/3pN3/4P1Q1/8/PPPP1PPP/RNB1KB1R w KQkq - 0 1");
 
-    const std::vector<Move> checks = board.getAllCheckMoves();
-    const std::vector<Move> captures = board.getAllCaptures();
-
-    assert(checks.size() == 1);
-    assert(captures.size() == 6);
-    assert(checks[0].mFromSquare == Stockfish::Square::SQ_G4);
-    assert(checks[0].mToSquare == Stockfish::Square::SQ_D7);
-    assert(captures[0].mFromSquare == Stockfish::Square::SQ_F1);
-    assert(captures[0].mToSquare == Stockfish::Square::SQ_A6);
-    assert(captures[1].mFromSquare == Stockfish::Square::SQ_E4);
-    assert(captures[1].mToSquare == Stockfish::Square::SQ_D5);
-    assert(captures[2].mFromSquare == Stockfish::Square::SQ_G4);
-    assert(captures[2].mToSquare == Stockfish::Square::SQ_D7);
-    assert(captures[3].mFromSquare == Stockfish::Square::SQ_G4);
-    assert(captures[3].mToSquare == Stockfish::Square::SQ_G7);
-    assert(captures[4].mFromSquare == Stockfish::Square::SQ_E5);
-    assert(captures[4].mToSquare == Stockfish::Square::SQ_D7);
-    assert(captures[5].mFromSquare == Stockfish::Square::SQ_E5);
-    assert(captures[5].mToSquare == Stockfish::Square::SQ_F7);
-}
-
-void Tests::RunTests()
-{
-    _countLegalMoves();
-    _captures();
-    _hanging();
-    _getBestMove();
-    _checksAndCaptures();
+    const MoveSpan checks = board.getAllCheckMoves();
+    const MoveSpan captures = board.getAllCaptures();
+
+    CHECK(checks.size() == 1);
+    CHECK(captures.size() == 6);
+    CHECK(checks[0].fromSquare() == Stockfish::Square::SQ_G4);
+    CHECK(checks[0].toSquare() == Stockfish::Square::SQ_D7);
+    CHECK(captures[0].fromSquare() == Stockfish::Square::SQ_F1);
+    CHECK(captures[0].toSquare() == Stockfish::Square::SQ_A6);
+    CHECK(captures[1].fromSquare() == Stockfish::Square::SQ_E4);
+    CHECK(captures[1].toSquare() == Stockfish::Square::SQ_D5);
+    CHECK(captures[2].fromSquare() == Stockfish::Square::SQ_G4);
+    CHECK(captures[2].toSquare() == Stockfish::Square::SQ_D7);
+    CHECK(captures[3].fromSquare() == Stockfish::Square::SQ_G4);
+    CHECK(captures[3].toSquare() == Stockfish::Square::SQ_G7);
+    CHECK(captures[4].fromSquare() == Stockfish::Square::SQ_E5);
+    CHECK(captures[4].toSquare() == Stockfish::Square::SQ_D7);
+    CHECK(captures[5].fromSquare() == Stockfish::Square::SQ_E5);
+    CHECK(captures[5].toSquare() == Stockfish::Square::SQ_F7);
+}
+
+void _captureTable()
+{
+    // hanging queen, taking it wins the whole queen
+    {
+        const Board board = _setupBoard("rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1");
+
+        const Capture* capture = board.findCapture(Stockfish::Square::SQ_F6, Stockfish::Square::SQ_H5);
+
+        CHECK(capture);
+        CHECK(capture->mVictim == Stockfish::W_QUEEN);
+        CHECK(capture->mExchangeGain == Stockfish::QueenValueMg);
+        CHECK(capture->mCapturesHangingPiece);
+        CHECK(board.getCaptureTable().size() == 2);
+        CHECK(!board.findCapture(Stockfish::Square::SQ_F6, Stockfish::Square::SQ_E4));
+    }
+
+    // queen takes a defended pawn and is taken back
+    {
+        const Board board = _setupBoard("4k3/8/2p5/3p4/8/8/8/3QK3 w - - 0 1");
+
+        const Capture* capture = board.findCapture(Stockfish::Square::SQ_D1, Stockfish::Square::SQ_D5);
+
+        CHECK(capture);
+        CHECK(capture->mExchangeGain == Stockfish::PawnValueMg - Stockfish::QueenValueMg);
+        CHECK(!capture->isWinningExchange());
+        CHECK(!capture->mCapturesHangingPiece);
+        CHECK(!board.isWinningCaptureStaticExchangeEvaluation(Stockfish::Square::SQ_D1, Stockfish::Square::SQ_D5));
+    }
+
+    // en passant takes a pawn that isn't on the square moved to
+    {
+        const Board board = _setupBoard("rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 1");
+
+        const Capture* capture = board.findCapture(Stockfish::Square::SQ_E5, Stockfish::Square::SQ_F6);
+
+        CHECK(capture);
+        CHECK(capture->mVictimSquare == Stockfish::Square::SQ_F5);
+        CHECK(capture->mVictim == Stockfish::B_PAWN);
+        CHECK(capture->mExchangeGain == Stockfish::VALUE_ZERO);
+        CHECK(!capture->mCapturesHangingPiece);
+    }
+}
+
+void _tactics()
+{
+    TacticsScanner scanner;
+
+    // knight forks king and rook
+    {
+        const Board board = _setupBoard("r3k3/8/8/3N4/8/8/8/4K3 w - - 0 1");
+
+        const Tactics& tactics = scanner.scan(board);
+
+        CHECK(tactics.mForks.size() == 1);
+        CHECK(tactics.mForks[0].mMove.toSquare() == Stockfish::Square::SQ_C7);
+        CHECK(tactics.mForks[0].mForkedPieces == (Stockfish::square_bb(Stockfish::Square::SQ_A8) | Stockfish::Square::SQ_E8));
+        CHECK(tactics.mSkewers.empty());
+    }
+
+    // a fork on a square the knight is lost on isn't one
+    {
+        const Board board = _setupBoard("r2bk3/8/8/3N4/8/8/8/4K3 w - - 0 1");
+
+        CHECK(scanner.scan(board).mForks.empty());
+    }
+
+    // rook checks the king, winning the queen behind it
+    {
+        const Board board = _setupBoard("q3k3/8/8/8/8/8/8/4K2R w - - 0 1");
+
+        const Tactics& tactics = scanner.scan(board);
+
+        CHECK(tactics.mSkewers.size() == 1);
+        CHECK(tactics.mSkewers[0].mMove.toSquare() == Stockfish::Square::SQ_H8);
+        CHECK(tactics.mSkewers[0].mFrontPiece == Stockfish::Square::SQ_E8);
+        CHECK(tactics.mSkewers[0].mPieceBehind == Stockfish::Square::SQ_A8);
+    }
+
+    // knight moves away for a discovered check
+    {
+        const Board board = _setupBoard("4k3/8/8/8/4N3/8/8/4R1K1 w - - 0 1");
+
+        const Tactics& tactics = scanner.scan(board);
+
+        CHECK(tactics.mDiscoveredAttacks.size() == 1);
+        CHECK(tactics.mDiscoveredAttacks[0].mMovingPiece == Stockfish::Square::SQ_E4);
+        CHECK(tactics.mDiscoveredAttacks[0].mSlider == Stockfish::Square::SQ_E1);
+        CHECK(tactics.mDiscoveredAttacks[0].mTarget == Stockfish::Square::SQ_E8);
+    }
+
+    // the queen alone defends both attacked minor pieces
+    {
+        const Board board = _setupBoard("4k3/3q4/2n1b3/8/B7/8/8/4RK2 w - - 0 1");
+
+        const Tactics& tactics = scanner.scan(board);
+
+        CHECK(tactics.mOverloadedDefenders.size() == 1);
+        CHECK(tactics.mOverloadedDefenders[0].mDefender == Stockfish::Square::SQ_D7);
+        CHECK(tactics.mOverloadedDefenders[0].mDefendedPieces == (Stockfish::square_bb(Stockfish::Square::SQ_C6) | Stockfish::Square::SQ_E6));
+    }
+
+    // nothing to find in the starting position
+    {
+        const Board board = _setupBoard("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+        CHECK(scanner.scan(board).empty());
+    }
+}
+
+void _featureExport()
+{
+    const std::vector<std::string> fenStrings = {
+        "rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1",
+        "rnbqk1nr/pppp1ppp/8/4p3/1b2P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+        "1r2k3/2P5/8/8/8/8/8/4K3 w - - 0 1",
+        "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1",
+    };
+
+    std::deque<Board> boards;
+    for (const std::string& fenString : fenStrings)
+    {
+        boards.emplace_back(fenString, false);
+    }
+
+    std::vector<int8_t> features(fenStrings.size() * FeatureExporter::NumFeatures);
+    std::vector<float> floatFeatures(features.size());
+    FeatureExporter::exportBatch(boards, features.data());
+    FeatureExporter::exportBatch(boards, floatFeatures.data());
+
+    // every plane agrees with the query it stands for, on a board that hasn't been asked anything yet
+    for (size_t i = 0; i < fenStrings.size(); ++i)
+    {
+        const Board board = _setupBoard(fenStrings[i]);
+        const int8_t* planes = features.data() + i * FeatureExporter::NumFeatures;
+        for (Stockfish::Square square = Stockfish::SQ_A1; square <= Stockfish::SQ_H8; ++square)
+        {
+            const auto feature = [planes, square](const FeaturePlane plane) { return static_cast<size_t>(planes[plane * Stockfish::SQUARE_NB + square]); };
+            CHECK(feature(LegalMovesPlane) == board.numLegalMovesOfPiece(square));
+            CHECK(feature(CapturesPlane) == board.numCapturesPossibleFromPiece(square));
+            CHECK(feature(PinnedPlane) == board.isPiecePinned(square));
+            CHECK(feature(HangingPlane) == board.isPieceHanging(square));
+        }
+    }
+
+    for (size_t i = 0; i < features.size(); ++i)
+    {
+        CHECK(floatFeatures[i] == features[i]);
+    }
+
+    // the queen on h5 is attacked by the knight on f6 and the pawn on g6, and defended by nothing
+    const int8_t* planes = features.data();
+    CHECK(planes[PiecePlane * Stockfish::SQUARE_NB + Stockfish::SQ_H5] == Stockfish::W_QUEEN);
+    CHECK(planes[PiecePlane * Stockfish::SQUARE_NB + Stockfish::SQ_H4] == Stockfish::NO_PIECE);
+    CHECK(planes[AttackersPlane * Stockfish::SQUARE_NB + Stockfish::SQ_H5] == 2);
+    CHECK(planes[DefendersPlane * Stockfish::SQUARE_NB + Stockfish::SQ_H5] == 0);
+    // the knight on f6 is only defended by the queen, the pawns that would are gone
+    CHECK(planes[DefendersPlane * Stockfish::SQUARE_NB + Stockfish::SQ_F6] == 1);
+    CHECK(planes[AttackersPlane * Stockfish::SQUARE_NB + Stockfish::SQ_F6] == 0);
+
+    // the pawn pinned by the bishop on b4 and the promotion captures of c7 come out of the second and fourth board
+    CHECK(features[FeatureExporter::NumFeatures + PinnedPlane * Stockfish::SQUARE_NB + Stockfish::SQ_D2] == 1);
+    CHECK(features[3 * FeatureExporter::NumFeatures + CapturesPlane * Stockfish::SQUARE_NB + Stockfish::SQ_C7] == 4);
+}
+
+void _applyAndUndoMoves()
+{
+    // walking a game gives the same answers as building each position from FEN
+    {
+        Board board = _setupBoard("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+
+        board.applyMove(Move(Stockfish::make_move(Stockfish::Square::SQ_E2, Stockfish::Square::SQ_E4)));
+        board.applyMove(Move(Stockfish::make_move(Stockfish::Square::SQ_D7, Stockfish::Square::SQ_D5)));
+
+        const Board expected = _setupBoard("rnbqkbnr/ppp1pppp/8/3p4/4P3/8/PPPP1PPP/RNBQKBNR w KQkq d6 0 2");
+
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_F1) == 5);
+        CHECK(board.numCapturesPossibleFromPiece(Stockfish::Square::SQ_E4) == 1);
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_D8) == expected.numLegalMovesOfPiece(Stockfish::Square::SQ_D8));
+        CHECK(board.getAllCaptures().size() == expected.getAllCaptures().size());
+        CHECK(!board.isPieceHanging(Stockfish::Square::SQ_D5));
+    }
+
+    // pins appear and disappear with the moves that create them
+    {
+        Board board = _setupBoard("rnbqkbnr/ppp2ppp/4p3/3p4/3PP3/2N5/PPP2PPP/R1BQKBNR b KQkq - 0 1");
+
+        CHECK(!board.isPiecePinned(Stockfish::Square::SQ_C3));
+
+        board.applyMove(Move(Stockfish::make_move(Stockfish::Square::SQ_F8, Stockfish::Square::SQ_B4)));
+
+        CHECK(board.isPiecePinned(Stockfish::Square::SQ_C3));
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_C3) == 0);
+        CHECK(board.isPieceHanging(Stockfish::Square::SQ_E4));
+
+        board.undoMove();
+
+        CHECK(!board.isPiecePinned(Stockfish::Square::SQ_C3));
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_C3) == 5);
+        CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_F8) == 5);
+    }
+}
+
+void _sanMoves()
+{
+    // pieces, pawns, captures, castling and the symbols PGN adds
+    {
+        const Board board = _setupBoard("r3k2r/pppq1ppp/2n2n2/3pp3/1b1PP3/2N1BN2/PPPQ1PPP/R3KB1R w KQkq - 0 1");
+
+        CHECK(board.findSanMove("Nxe5")->fromSquare() == Stockfish::Square::SQ_F3);
+        CHECK(board.findSanMove("dxe5!?")->fromSquare() == Stockfish::Square::SQ_D4);
+        CHECK(board.findSanMove("exd5")->fromSquare() == Stockfish::Square::SQ_E4);
+        CHECK(board.findSanMove("a3")->toSquare() == Stockfish::Square::SQ_A3);
+        CHECK(board.findSanMove("Qd3")->fromSquare() == Stockfish::Square::SQ_D2);
+        CHECK(board.findSanMove("O-O-O")->typeOfMove() == Stockfish::MoveType::CASTLING);
+        CHECK(board.findSanMove("0-0-0")->typeOfMove() == Stockfish::MoveType::CASTLING);
+
+        // not legal here, or not a move at all
+        CHECK(!board.findSanMove("O-O"));
+        CHECK(!board.findSanMove("Nc3"));
+        CHECK(!board.findSanMove("e4"));
+        CHECK(!board.findSanMove("qe7"));
+        CHECK(!board.findSanMove(""));
+    }
+
+    // a move two pieces can make needs the file or rank of the one moving
+    {
+        const Board board = _setupBoard("4k3/8/8/8/8/8/8/R4RK1 w - - 0 1");
+
+        CHECK(!board.findSanMove("Rd1"));
+        CHECK(board.findSanMove("Rad1")->fromSquare() == Stockfish::Square::SQ_A1);
+        CHECK(board.findSanMove("Rfd1+")->fromSquare() == Stockfish::Square::SQ_F1);
+        CHECK(board.findSanMove("Rf1d1")->fromSquare() == Stockfish::Square::SQ_F1);
+        CHECK(board.findSanMove("Ra2")->fromSquare() == Stockfish::Square::SQ_A1);
+    }
+
+    // promotions, a missing piece means a queen
+    {
+        const Board board = _setupBoard("1n2k3/P7/8/8/8/8/8/4K3 w - - 0 1");
+
+        CHECK(board.findSanMove("a8=Q")->promotionType() == Stockfish::PieceType::QUEEN);
+        CHECK(board.findSanMove("a8N")->promotionType() == Stockfish::PieceType::KNIGHT);
+        CHECK(board.findSanMove("axb8=R#")->promotionType() == Stockfish::PieceType::ROOK);
+        CHECK(board.findSanMove("axb8")->promotionType() == Stockfish::PieceType::QUEEN);
+        CHECK(!board.findSanMove("a8=K"));
+    }
+}
+
+void _pgnPipeline()
+{
+    // comments, variations, annotation glyphs and escape lines are skipped, a game without a result ends at the next
+    // game's tags
+    std::stringstream pgn;
+    pgn << "% exported by a test\n"
+        << "[Event \"Example\"]\n"
+        << "[White \"Morphy\"]\n"
+        << "[Black \"Duke \\\"Karl\\\"\"]\n"
+        << "\n"
+        << "1. e4 e5 2. Nf3 d6 {the Philidor\n"
+        << "defence} 3. d4 Bg4 (3... exd4 4. Nxd4 $1) 4.dxe5 Bxf3 5. Qxf3 dxe5 6. Bc4 Nf6 7. Qb3 qe7 ; a typo\n"
+        << "8. Nc3 1-0\n"
+        << "\n"
+        << "[Event \"Fork\"]\n"
+        << "[FEN \"r3k3/8/8/8/8/8/8/4KN2 w - - 0 1\"]\n"
+        << "1. Ne3 Rb8 2. Nd5 Ra8 3. Nc7+!! *\n"
+        << "[Event \"Unfinished\"]\n"
+        << "1.e4 e5 2.Ke2\n";
+
+    std::vector<GameAnnotation> annotations;
+    GamePipeline pipeline(std::nullopt, 1);
+    pipeline.analyze(pgn, [&annotations](const GameAnnotation& annotation)
+        {
+            annotations.push_back(annotation);
+        });
+
+    CHECK(annotations.size() == 3);
+    CHECK(pipeline.statistics().mNumGames == 3);
+
+    // the first game stops at the move that can't be read
+    const GameAnnotation& philidor = annotations[0];
+    CHECK(philidor.mGame.tag("Black") == "Duke \"Karl\"");
+    CHECK(philidor.mGame.mResult == "1-0");
+    CHECK(philidor.mGame.mSanMoves.size() == 15);
+    CHECK(philidor.mPlies.size() == 13);
+    CHECK(!philidor.mError.empty());
+    CHECK(philidor.mPlies[0].mNumLegalMoves == 20);
+    CHECK(philidor.mPlies[6].mSan == "dxe5");
+    CHECK(philidor.mPlies[6].mIsCapture);
+    CHECK(philidor.mPlies[12].mGivesCheck == false);
+    CHECK(philidor.mPlies[8].mIsCapture && philidor.mPlies[8].mExchangeGain > Stockfish::VALUE_ZERO);
+    CHECK(philidor.mPlies[1].mFen == "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1");
+    CHECK(philidor.mPlies[0].mBestMoves.empty());
+
+    // the knight move forking king and rook is found as one
+    const GameAnnotation& fork = annotations[1];
+    CHECK(fork.mError.empty());
+    CHECK(fork.mGame.mResult == "*");
+    CHECK(fork.mPlies.size() == 5);
+    CHECK(fork.mPlies[4].mPlayedFork);
+    CHECK(fork.mPlies[4].mGivesCheck);
+    CHECK(!fork.mPlies[0].mPlayedFork);
+
+    const GameAnnotation& unfinished = annotations[2];
+    CHECK(unfinished.mGame.tag("Event") == "Unfinished");
+    CHECK(unfinished.mGame.mResult.empty());
+    CHECK(unfinished.mPlies.size() == 3);
+
+    CHECK(pipeline.statistics().mNumPlies == 13 + 5 + 3);
+}
+
+void _pipelineErrors()
+{
+    const std::string pgnText = "[Event \"One\"]\n1. e4 e5 2. Nf3 *\n[Event \"Two\"]\n1. d4 d5 *\n";
+
+    // a stage that throws doesn't take the program down, the exception comes out of analyze() once every stage is done
+    AnalysisLimits noLimit;
+    noLimit.mDepth = 0;
+    std::stringstream pgn(pgnText);
+    GamePipeline searchingPipeline(noLimit, 1);
+    bool threw = false;
+    try
+    {
+        searchingPipeline.analyze(pgn, [](const GameAnnotation&) {});
+    }
+    catch (const std::invalid_argument&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+    CHECK(searchingPipeline.statistics().mNumGames == 0);
+
+    // the same for the stage reading the stream
+    class FailingBuffer : public std::streambuf
+    {
+    protected:
+        int_type underflow() override
+        {
+            throw std::runtime_error("read error");
+        }
+    };
+    FailingBuffer failingBuffer;
+    std::istream failingStream(&failingBuffer);
+    failingStream.exceptions(std::ios::badbit);
+    GamePipeline readingPipeline(std::nullopt, 1);
+    threw = false;
+    try
+    {
+        readingPipeline.analyze(failingStream, [](const GameAnnotation&) {});
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+    CHECK(threw);
+}
+
+void _searchedPgnPipeline()
+{
+    std::stringstream pgn("1. e4 e5 2. Qh5 Nf6 3. Qxe5+ Be7 *\n");
+
+    AnalysisLimits limits;
+    limits.mDepth = 8;
+    limits.mMultiPV = 2;
+
+    GamePipeline pipeline(limits);
+    size_t numGames = 0;
+    pipeline.analyze(pgn, [&numGames](const GameAnnotation& annotation)
+        {
+            ++numGames;
+            CHECK(annotation.mPlies.size() == 6);
+            CHECK(annotation.mPlies[0].mBestMoves.size() == 2);
+            // Nf6 hangs e5, which the search sees
+            CHECK(annotation.mPlies[4].mPlayedBestMove);
+            CHECK(annotation.mPlies[4].mCapturesHangingPiece);
+        });
+
+    CHECK(numGames == 1);
+}
+
+void _lazyQueries()
+{
+    // facts are only worked out when first asked for, the answers can't depend on the order they're asked in
+    {
+        const std::string fenString = "rnbqk1nr/ppp2ppp/4p3/3p4/1b1PP3/2N5/PPP2PPP/R1BQKBNR w KQkq - 0 1";
+        const Board opponentFirst = _setupBoard(fenString);
+        const Board sideToMoveFirst = _setupBoard(fenString);
+
+        const bool isHanging = opponentFirst.isPieceHanging(Stockfish::Square::SQ_E4);
+        const size_t numBishopMoves = opponentFirst.numLegalMovesOfPiece(Stockfish::Square::SQ_B4);
+        const size_t numCaptures = opponentFirst.getAllCaptures().size();
+
+        CHECK(sideToMoveFirst.getAllCaptures().size() == numCaptures);
+        CHECK(sideToMoveFirst.numLegalMovesOfPiece(Stockfish::Square::SQ_B4) == numBishopMoves);
+        CHECK(sideToMoveFirst.isPieceHanging(Stockfish::Square::SQ_E4) == isHanging);
+        CHECK(isHanging);
+        CHECK(numBishopMoves == 7);
+    }
+
+    // remembered static exchange results don't leak into the next position
+    {
+        Board board = _setupBoard("rnbqkbnr/ppp1pppp/8/3p4/4P3/7P/PPPP1PP1/RNBQKBNR b KQkq - 0 1");
+
+        CHECK(board.isWinningCaptureStaticExchangeEvaluation(Stockfish::Square::SQ_D5, Stockfish::Square::SQ_E4));
+        CHECK(board.isWinningCaptureStaticExchangeEvaluation(Stockfish::Square::SQ_D5, Stockfish::Square::SQ_E4));
+
+        board.applyMove(Move(Stockfish::make_move(Stockfish::Square::SQ_B8, Stockfish::Square::SQ_C6)));
+        board.applyMove(Move(Stockfish::make_move(Stockfish::Square::SQ_B1, Stockfish::Square::SQ_C3)));
+
+        CHECK(board.isWinningCaptureStaticExchangeEvaluation(Stockfish::Square::SQ_D5, Stockfish::Square::SQ_E4));
+
+        board.applyMove(Move(Stockfish::make_move(Stockfish::Square::SQ_G8, Stockfish::Square::SQ_F6)));
+        board.applyMove(Move(Stockfish::make_move(Stockfish::Square::SQ_D2, Stockfish::Square::SQ_D3)));
+
+        // with e4 defended twice, the pawn still trades evenly but the knight would be lost for a pawn
+        CHECK(board.isWinningCaptureStaticExchangeEvaluation(Stockfish::Square::SQ_D5, Stockfish::Square::SQ_E4));
+        CHECK(!board.isWinningCaptureStaticExchangeEvaluation(Stockfish::Square::SQ_F6, Stockfish::Square::SQ_E4));
+    }
+
+    // a board that should be analyzed only searches once its best moves are asked for
+    {
+        const Board board = _setupBoard("rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1", true);
+
+        CHECK(board.isPieceHanging(Stockfish::Square::SQ_H5));
+        CHECK(board.getBestMoves(1)[0].fromSquare() == Stockfish::Square::SQ_F6);
+        CHECK(board.getBestMoves(5).size() == 5);
+    }
+}
+
+void _analysisCache()
+{
+    const std::string fileName = "AnalysisCacheTest.bin";
+    const std::string fenString = "rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1";
+    std::remove(fileName.c_str());
+
+    AnalysisLimits limits;
+    limits.mDepth = 6;
+    limits.mMultiPV = 3;
+
+    // the first run searches and keeps the result
+    std::vector<Move> bestMoves;
+    {
+        AnalysisCache cache(fileName, 64);
+        CHECK(cache.isOpen());
+
+        const Board board(fenString, limits, cache);
+        bestMoves = board.getBestMoves(3).toVector();
+
+        CHECK(bestMoves.size() == 3);
+        CHECK(cache.numRecords() == 1);
+    }
+
+    // the next run reads it back from the file instead of searching
+    {
+        AnalysisCache cache(fileName);
+        CHECK(cache.numRecords() == 1);
+
+        AnalysisLimits otherLimits;
+        otherLimits.mDepth = 1;
+        const Board otherBoard("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", otherLimits);
+        const uint64_t nodesSearched = Stockfish::Threads.nodes_searched();
+
+        const Board board(fenString, limits, cache);
+        const MoveSpan cachedBestMoves = board.getBestMoves(3);
+
+        CHECK(Stockfish::Threads.nodes_searched() == nodesSearched);
+        CHECK(cachedBestMoves.size() == 3);
+        for (size_t i = 0; i < cachedBestMoves.size(); ++i)
+        {
+            CHECK(cachedBestMoves[i].stockfishMove() == bestMoves[i].stockfishMove());
+        }
+        CHECK(board.isPieceHanging(Stockfish::Square::SQ_H5));
+        CHECK(board.findCapture(Stockfish::Square::SQ_F6, Stockfish::Square::SQ_H5)->mExchangeGain == Stockfish::QueenValueMg);
+    }
+
+    // asking for a deeper search than the cache has searches again and replaces the record
+    {
+        AnalysisCache cache(fileName);
+
+        limits.mDepth = 7;
+        const Board board(fenString, limits, cache);
+        const uint64_t nodesSearched = Stockfish::Threads.nodes_searched();
+        const Board again(fenString, limits, cache);
+
+        CHECK(nodesSearched > 0);
+        CHECK(Stockfish::Threads.nodes_searched() == nodesSearched);
+        CHECK(cache.numRecords() == 1);
+    }
+
+    // more principal variations than the deeper record has also search again, and the result then replaces it
+    {
+        AnalysisCache cache(fileName);
+
+        AnalysisLimits widerLimits;
+        widerLimits.mDepth = 6;
+        widerLimits.mMultiPV = 5;
+        const Board board(fenString, widerLimits, cache);
+        const uint64_t nodesSearched = Stockfish::Threads.nodes_searched();
+        const Board again(fenString, widerLimits, cache);
+
+        CHECK(nodesSearched > 0);
+        CHECK(Stockfish::Threads.nodes_searched() == nodesSearched);
+        CHECK(again.getBestMoves(5).size() == 5);
+    }
+
+    // a node limit doesn't say how deep a record has to be, so it always searches
+    {
+        AnalysisCache cache(fileName);
+
+        AnalysisLimits nodeLimits;
+        nodeLimits.mDepth = 0;
+        nodeLimits.mNodes = 2000;
+        const uint64_t nodesBefore = Stockfish::Threads.nodes_searched();
+        const Board board(fenString, nodeLimits, cache);
+
+        CHECK(Stockfish::Threads.nodes_searched() != nodesBefore);
+    }
+
+    // a position without legal moves is kept as deep as it was asked for, so it isn't searched again
+    {
+        AnalysisCache cache(fileName);
+
+        const std::string stalemate = "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1";
+        const Board board(stalemate, limits, cache);
+        const size_t numRecords = cache.numRecords();
+        const Board otherBoard(fenString, limits);
+        const uint64_t nodesSearched = Stockfish::Threads.nodes_searched();
+        const Board again(stalemate, limits, cache);
+
+        CHECK(numRecords == 2);
+        CHECK(Stockfish::Threads.nodes_searched() == nodesSearched);
+        CHECK(again.getBestMoves(5).empty());
+    }
+
+    std::remove(fileName.c_str());
+}
+
+void _hashFile()
+{
+    const std::string fileName = "HashFileTest.bin";
+    const std::string fenString = "rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1";
+    std::remove(fileName.c_str());
+
+    AnalysisLimits limits;
+    limits.mDepth = 10;
+
+    Stockfish::Search::clear();
+    Board board(fenString, limits);
+    const std::vector<Move> bestMoves = board.getBestMoves(1).toVector();
+    CHECK(Stockfish::TT.save(fileName));
+
+    // an empty table searches everything again, the saved one knows most of it already
+    Stockfish::Search::clear();
+    board.analyze(limits);
+    const uint64_t coldNodes = Stockfish::Threads.nodes_searched();
+
+    CHECK(Stockfish::TT.load(fileName));
+    board.analyze(limits);
+    CHECK(Stockfish::Threads.nodes_searched() < coldNodes);
+    CHECK(board.getBestMoves(1).toVector() == bestMoves);
+
+    // saving over the file it was loaded from keeps what was loaded
+    CHECK(Stockfish::TT.save(fileName));
+    CHECK(Stockfish::TT.load(fileName));
+    board.analyze(limits);
+    CHECK(Stockfish::Threads.nodes_searched() < coldNodes);
+
+    // files that aren't a saved table of this size are refused
+    CHECK(!Stockfish::TT.load("NoSuchHashFile.bin"));
+    {
+        std::ofstream file(fileName, std::ios::binary | std::ios::trunc);
+        file << "not a hash";
+    }
+    CHECK(!Stockfish::TT.load(fileName));
+
+    Stockfish::Search::clear();
+    std::remove(fileName.c_str());
+}
+
+void _hashResize()
+{
+    const std::string fenString = "rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1";
+    const size_t hashMB = size_t(Stockfish::Options["Hash"]);
+
+    AnalysisLimits limits;
+    limits.mDepth = 10;
+
+    Stockfish::Search::clear();
+    const Board board(fenString, limits);
+
+    // the root of the search is the deepest entry there is, with "Keep Hash" growing and shrinking the hash keeps it
+    bool found = false;
+    Stockfish::TT.probe(board.key(), found);
+    CHECK(found);
+    Stockfish::Options["Keep Hash"] = std::string("true");
+    for (const size_t size : { 4 * hashMB, size_t(1), hashMB })
+    {
+        Stockfish::Options["Hash"] = std::to_string(size);
+        found = false;
+        const Stockfish::TTEntry* const entry = Stockfish::TT.probe(board.key(), found);
+        CHECK(found);
+        CHECK(found && entry->move() != Stockfish::MOVE_NONE);
+    }
+
+    // without it a new size clears the table, like it always did
+    Stockfish::Options["Keep Hash"] = std::string("false");
+    Stockfish::Options["Hash"] = std::to_string(2 * hashMB);
+    Stockfish::TT.probe(board.key(), found);
+    CHECK(!found);
+
+    Stockfish::Options["Hash"] = std::to_string(hashMB);
+    Stockfish::Search::clear();
+}
+
+void _hashStatistics()
+{
+    AnalysisLimits limits;
+    limits.mDepth = 10;
+    const Board board("rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1", limits);
+
+    // counted for the last search
+    const std::array<uint64_t, Stockfish::TTStats::COUNTER_NB> counters = Stockfish::TT.counters();
+    CHECK(counters[Stockfish::TTStats::PROBES] > 0);
+    CHECK(counters[Stockfish::TTStats::HITS] > 0);
+    CHECK(counters[Stockfish::TTStats::HITS] <= counters[Stockfish::TTStats::PROBES]);
+    CHECK(counters[Stockfish::TTStats::USABLE_HITS] <= counters[Stockfish::TTStats::HITS]);
+    CHECK(counters[Stockfish::TTStats::SAVES_EMPTY] + counters[Stockfish::TTStats::SAVES_SAME] > 0);
+
+    const std::string report = Stockfish::TT.stats_info();
+    CHECK(report.find("info string hash probes " + std::to_string(counters[Stockfish::TTStats::PROBES])) == 0);
+    CHECK(report.find("info string hash age") != std::string::npos);
+}
+
+void _batchAnalysis()
+{
+    const std::vector<std::string> fenStrings = {
+        "rnbqkbnr/ppp1pppp/8/3p4/4P3/7P/PPPP1PP1/RNBQKBNR b KQkq - 0 1",
+        "rnbqk1nr/ppp2ppp/4p3/3p4/1b1PP3/2N5/PPP2PPP/R1BQKBNR w KQkq - 0 1",
+        "4k3/8/2p1p3/1p3p2/3N4/1p3p2/2p1p3/4K3 w - - 0 1",
+    };
+
+    // results come back in order, and each board stays usable after the ones following it were built
+    {
+        BoardBatchAnalyzer analyzer(false);
+        const std::deque<Board>& boards = analyzer.analyze(fenStrings);
+
+        CHECK(boards.size() == 3);
+        CHECK(boards[0].isPieceHanging(Stockfish::Square::SQ_E4));
+        CHECK(boards[1].isPiecePinned(Stockfish::Square::SQ_C3));
+        CHECK(boards[2].numCapturesPossibleFromPiece(Stockfish::Square::SQ_D4) == 8);
+        CHECK(analyzer.statistics().mNumPositions == 3);
+    }
+
+    // streaming skips empty lines
+    {
+        std::stringstream fenStream;
+        fenStream << fenStrings[0] << "\n\n" << fenStrings[2] << "\n";
+
+        BoardBatchAnalyzer analyzer(false);
+        size_t numCaptures = 0;
+        analyzer.analyze(fenStream, [&numCaptures](const Board& board)
+            {
+                numCaptures += board.getAllCaptures().size();
+            });
+
+        CHECK(analyzer.statistics().mNumPositions == 2);
+        CHECK(numCaptures == 10);
+    }
+}
+
+void _parallelBatchAnalysis()
+{
+    // more positions than search threads, so they're searched in several groups
+    const std::string hangingQueen = "rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1";
+    const std::string stalemate = "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1";
+    std::vector<std::string> fenStrings;
+    for (size_t i = 0; i < Stockfish::Threads.size() + 3; ++i)
+    {
+        fenStrings.push_back(i % 3 == 2 ? stalemate : hangingQueen);
+    }
+
+    AnalysisLimits limits;
+    limits.mDepth = 8;
+    limits.mMultiPV = 2;
+
+    // every position is searched on its own, so each gets its own best moves
+    {
+        BoardBatchAnalyzer analyzer(limits);
+        const std::deque<Board>& boards = analyzer.analyze(fenStrings);
+
+        CHECK(boards.size() == fenStrings.size());
+        for (size_t i = 0; i < boards.size(); ++i)
+        {
+            const MoveSpan bestMoves = boards[i].getBestMoves(2);
+            if (i % 3 == 2)
+            {
+                CHECK(bestMoves.empty());
+            }
+            else
+            {
+                CHECK(bestMoves.size() == 2);
+                CHECK(bestMoves[0].fromSquare() == Stockfish::Square::SQ_F6);
+            }
+        }
+    }
+
+    // streamed positions come back in order
+    {
+        std::stringstream fenStream;
+        for (const std::string& fenString : fenStrings)
+        {
+            fenStream << fenString << "\n";
+        }
+
+        BoardBatchAnalyzer analyzer(limits);
+        size_t numBoards = 0;
+        analyzer.analyze(fenStream, [&numBoards](const Board& board)
+            {
+                CHECK(board.getBestMoves(1).size() == (numBoards % 3 == 2 ? 0 : 1));
+                ++numBoards;
+            });
+
+        CHECK(numBoards == fenStrings.size());
+        CHECK(analyzer.statistics().mNumPositions == fenStrings.size());
+    }
+}
+
+void _analysisSession()
+{
+    // the opening of Morphy's opera game, searched after every move
+    const std::vector<std::string> game = { "e4", "e5", "Nf3", "d6", "d4", "Bg4", "dxe5", "Bxf3", "Qxf3", "dxe5", "Bc4", "Nf6" };
+
+    AnalysisLimits limits;
+    limits.mDepth = 10;
+    limits.mMultiPV = 1;
+
+    const auto analyzeGame = [&game, &limits](AnalysisSession& session)
+        {
+            for (const std::string& san : game)
+            {
+                CHECK(session.analyze().size() == 1);
+
+                const std::optional<Move> move = session.board().findSanMove(san);
+                CHECK(move);
+                session.applyMove(*move);
+            }
+        };
+
+    AnalysisSession cold("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", limits, false);
+    analyzeGame(cold);
+
+    AnalysisSession warm("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", limits);
+    analyzeGame(warm);
+
+    CHECK(warm.board().fen() == cold.board().fen());
+    CHECK(warm.board().numLegalMovesOfPiece(Stockfish::Square::SQ_F3) == 14);
+    CHECK(warm.statistics().mNumSearches == game.size());
+    CHECK(cold.statistics().mNumSearches == game.size());
+    CHECK(warm.statistics().mNumExpectedMoves > 0);
+    CHECK(warm.statistics().nodeSavingsOver(cold.statistics()) > 0.0);
+
+    // the hanging queen is still found when the search expected something else
+    AnalysisSession session("rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1", limits);
+    CHECK(session.analyze()[0].fromSquare() == Stockfish::Square::SQ_F6);
+}
+
+void _searchPoolOptions()
+{
+    // the pool's options are taken out wherever they are, the rest is left for the mode
+    std::vector<std::string> args = { "--threads", "3", "pgn", "--hash", "64", "games.pgn", "--bind", "off", "12",
+        "--hash-file", "hash.bin" };
+    const SearchPoolOptions options = SearchPoolOptions::parse(args);
+
+    CHECK(options.mNumThreads == 3);
+    CHECK(options.mHashMB == 64);
+    CHECK(options.mBindThreads == "off");
+    CHECK(options.mHashFile == "hash.bin");
+    CHECK(args == std::vector<std::string>({ "pgn", "games.pgn", "12" }));
+
+    std::vector<std::string> noOptions = { "--jobs", "2" };
+    CHECK(SearchPoolOptions::parse(noOptions).mNumThreads == 0);
+    CHECK(noOptions.size() == 2);
+
+    for (std::vector<std::string> badArgs : { std::vector<std::string>{ "--bind", "sometimes" }, std::vector<std::string>{ "--hash" } })
+    {
+        bool threw = false;
+        try
+        {
+            SearchPoolOptions::parse(badArgs);
+        }
+        catch (const std::invalid_argument&)
+        {
+            threw = true;
+        }
+        CHECK(threw);
+    }
+}
+
+void _positionKeys()
+{
+    // keyOf() agrees with the key of the board it would set up
+    const std::vector<std::string> fenStrings = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1",
+        "rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 3",
+        "r3k2r/8/8/8/8/8/8/R3K2R w Kq - 5 20",
+        "7k/5Q2/6K1/8/8/8/8/8 b - - 0 1",
+    };
+    for (const std::string& fenString : fenStrings)
+    {
+        CHECK(Board::keyOf(fenString) == _setupBoard(fenString).key());
+    }
+
+    // the move counters aren't part of the position until the halfmove clock gets to 14, an en passant square no pawn
+    // can capture on isn't either
+    CHECK(Board::keyOf("r3k2r/8/8/8/8/8/8/R3K2R w Kq - 5 20") == Board::keyOf("r3k2r/8/8/8/8/8/8/R3K2R w Kq - 0 1"));
+    CHECK(Board::keyOf("r3k2r/8/8/8/8/8/8/R3K2R w Kq - 14 20") != Board::keyOf("r3k2r/8/8/8/8/8/8/R3K2R w Kq - 13 20"));
+    CHECK(Board::keyOf("r3k2r/8/8/8/8/8/8/R3K2R w Kq - 21 20") == _setupBoard("r3k2r/8/8/8/8/8/8/R3K2R w Kq - 21 20").key());
+    CHECK(Board::keyOf(fenStrings[1]) == Board::keyOf("rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 1"));
+    CHECK(Board::keyOf(fenStrings[2]) != Board::keyOf("rnbqkbnr/ppp1pppp/8/8/3pP3/8/PPPP1PPP/RNBQKBNR b KQkq - 0 3"));
+    CHECK(Board::keyOf("r3k2r/8/8/8/8/8/8/R3K2R w Kq - 0 1") != Board::keyOf("r3k2r/8/8/8/8/8/8/R3K2R w KQq - 0 1"));
+    CHECK(Board::keyOf(fenStrings[4]) != Board::keyOf("7k/5Q2/6K1/8/8/8/8/8 w - - 0 1"));
+
+    // keys follow the moves played
+    Board board = _setupBoard(fenStrings[0]);
+    for (const char* san : { "e4", "d5", "e5", "f5" })
+    {
+        board.applyMove(*board.findSanMove(san));
+        CHECK(board.key() == Board::keyOf(board.fen()));
+    }
+    board.undoMove();
+    CHECK(board.key() == Board::keyOf("rnbqkbnr/ppp1pppp/8/3pP3/8/8/PPPP1PPP/RNBQKBNR b KQkq - 0 2"));
+}
+
+void _boardCache()
+{
+    // every position two moves in
+    std::vector<std::string> fenStrings;
+    const Board start = _setupBoard("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1");
+    for (const Move& whiteMove : start.getLegalMoves())
+    {
+        Board board = _setupBoard(start.fen());
+        board.applyMove(whiteMove);
+        for (const Move& blackMove : board.getLegalMoves().toVector())
+        {
+            board.applyMove(blackMove);
+            fenStrings.push_back(board.fen());
+            board.undoMove();
+        }
+    }
+    CHECK(fenStrings.size() == 400);
+
+    // a position asked for again is the same board, whatever its move counters
+    {
+        BoardCache cache;
+        const std::shared_ptr<const Board> board = cache.get(fenStrings[0]);
+
+        CHECK(cache.get(fenStrings[0]) == board);
+        CHECK(cache.find(board->key(), std::nullopt) == board);
+        CHECK(cache.get(board->fen().substr(0, board->fen().rfind(' ')) + " 9") == board);
+        CHECK(cache.get(fenStrings[1]) != board);
+        CHECK(board->getBestMoves(1).empty());
+        CHECK(cache.size() == 2);
+        CHECK(cache.statistics().mNumHits == 3);
+        CHECK(cache.statistics().mNumMisses == 2);
+    }
+
+    // beyond its capacity the cache drops the boards that were used least recently
+    {
+        BoardCache cache(32);
+        const std::shared_ptr<const Board> kept = cache.get(fenStrings[0]);
+        const std::shared_ptr<const Board> dropped = cache.get(fenStrings[1]);
+        for (size_t i = 2; i < fenStrings.size(); ++i)
+        {
+            cache.get(fenStrings[i]);
+            cache.get(fenStrings[0]);
+        }
+
+        CHECK(cache.capacity() == 32);
+        CHECK(cache.size() <= cache.capacity());
+        CHECK(cache.statistics().mNumEvictions == fenStrings.size() - cache.size());
+        CHECK(cache.find(kept->key(), std::nullopt) == kept);
+        CHECK(!cache.find(dropped->key(), std::nullopt));
+        // boards handed out outlive their eviction
+        CHECK(dropped->numLegalMoves() == _setupBoard(fenStrings[1]).numLegalMoves());
+    }
+
+    // threads asking for the same positions share one board each, and can query it at the same time
+    {
+        BoardCache cache;
+        const size_t numThreads = 4;
+        std::vector<std::vector<std::shared_ptr<const Board>>> boards(numThreads);
+        std::vector<std::vector<size_t>> numWinningCaptures(numThreads);
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < numThreads; ++t)
+        {
+            threads.emplace_back([&cache, &fenStrings, &boards, &numWinningCaptures, t]()
+                {
+                    for (const std::string& fenString : fenStrings)
+                    {
+                        const std::shared_ptr<const Board> board = cache.get(fenString);
+                        size_t numWinning = 0;
+                        for (const Move& move : board->getAllCaptures())
+                        {
+                            numWinning += board->isWinningCaptureStaticExchangeEvaluation(move.fromSquare(), move.toSquare());
+                        }
+
+                        boards[t].push_back(board);
+                        numWinningCaptures[t].push_back(numWinning);
+                    }
+                });
+        }
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        CHECK(cache.size() == fenStrings.size());
+        CHECK(cache.statistics().mNumHits + cache.statistics().mNumMisses == numThreads * fenStrings.size());
+        for (size_t t = 1; t < numThreads; ++t)
+        {
+            CHECK(boards[t] == boards[0]);
+            CHECK(numWinningCaptures[t] == numWinningCaptures[0]);
+        }
+    }
+}
+
+void _analyzedBoardCache()
+{
+    const std::string fenString = "rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1";
+
+    AnalysisLimits limits;
+    limits.mDepth = 8;
+    limits.mMultiPV = 2;
+
+    BoardCache cache;
+    const std::shared_ptr<const Board> board = cache.get(fenString, limits);
+    CHECK(board->getBestMoves(2).size() == 2);
+    CHECK(board->getBestMoves(2)[0].fromSquare() == Stockfish::Square::SQ_F6);
+
+    // found again without searching
+    const uint64_t nodesSearched = Stockfish::Threads.nodes_searched();
+    CHECK(cache.get(fenString, limits) == board);
+    CHECK(cache.find(Board::keyOf(fenString), limits) == board);
+    CHECK(Stockfish::Threads.nodes_searched() == nodesSearched);
+
+    // other limits, or no search at all, are other boards
+    AnalysisLimits deeper = limits;
+    deeper.mDepth = 9;
+    CHECK(cache.get(fenString, deeper) != board);
+    CHECK(cache.get(fenString) != board);
+    CHECK(cache.get(fenString)->getBestMoves(1).empty());
+    CHECK(cache.size() == 3);
+}
+
+void _asyncAnalysis()
+{
+    const std::string fenString = "rnbqkb1r/pppp1p1p/5np1/4p2Q/8/4PP1P/PPPP2P1/RNB1KBNR b KQkq - 0 1";
+
+    AnalysisLimits limits;
+    limits.mDepth = 8;
+    limits.mMultiPV = 2;
+
+    Board board(fenString, false);
+    int numCallbacks = 0;
+    int callbackDepth = 0;
+    const std::shared_future<std::vector<Move>> bestMoves = board.analyzeAsync(limits,
+        [&numCallbacks, &callbackDepth](MoveSpan, const int depth)
+        {
+            ++numCallbacks;
+            callbackDepth = depth;
+        });
+
+    // answered while the search runs
+    CHECK(board.isPieceHanging(Stockfish::Square::SQ_H5));
+    CHECK(board.numLegalMovesOfPiece(Stockfish::Square::SQ_F6) == 5);
+
+    CHECK(bestMoves.get().size() == 2);
+    CHECK(bestMoves.get()[0].fromSquare() == Stockfish::Square::SQ_F6);
+    CHECK(numCallbacks == 1);
+    CHECK(callbackDepth == limits.mDepth);
+    CHECK(board.getBestMoves(2).toVector() == bestMoves.get());
+
+    // queued searches finish in the order they were asked for, and getBestMoves() waits for its own
+    std::deque<Board> boards;
+    std::vector<std::shared_future<std::vector<Move>>> futures;
+    std::vector<size_t> finished;
+    for (size_t i = 0; i < 3; ++i)
+    {
+        boards.emplace_back(fenString, false);
+        futures.push_back(boards.back().analyzeAsync(limits, [&finished, i](MoveSpan, int) { finished.push_back(i); }));
+    }
+    CHECK(boards.back().getBestMoves(1)[0].fromSquare() == Stockfish::Square::SQ_F6);
+    CHECK(finished == std::vector<size_t>({ 0, 1, 2 }));
+}
+
+size_t Tests::RunTests(const std::vector<std::string>& args)
+{
+    TestRunnerOptions options;
+    try
+    {
+        options = TestRunnerOptions::parse(args);
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << exception.what() << std::endl;
+        return 1;
+    }
+
+    // cases that search, or wait on the search threads, share the engine and can't run alongside each other
+    TestRunner runner(options);
+    runner.add("countLegalMoves", _countLegalMoves);
+    runner.add("moveSpans", _moveSpans);
+    runner.add("captures", _captures);
+    runner.add("hanging", _hanging);
+    runner.add("getBestMove", _getBestMove, true);
+    runner.add("streamBestMoves", _streamBestMoves, true);
+    runner.add("invalidAnalysisLimits", _invalidAnalysisLimits, true);
+    runner.add("checksAndCaptures", _checksAndCaptures);
+    runner.add("captureTable", _captureTable);
+    runner.add("tactics", _tactics);
+    runner.add("featureExport", _featureExport);
+    runner.add("applyAndUndoMoves", _applyAndUndoMoves);
+    runner.add("sanMoves", _sanMoves);
+    runner.add("pgnPipeline", _pgnPipeline);
+    runner.add("searchPoolOptions", _searchPoolOptions);
+    runner.add("positionKeys", _positionKeys);
+    runner.add("boardCache", _boardCache);
+    runner.add("lazyQueries", _lazyQueries, true);
+    runner.add("analysisCache", _analysisCache, true);
+    runner.add("hashFile", _hashFile, true);
+    runner.add("hashResize", _hashResize, true);
+    runner.add("hashStatistics", _hashStatistics, true);
+    runner.add("batchAnalysis", _batchAnalysis, true);
+    runner.add("parallelBatchAnalysis", _parallelBatchAnalysis, true);
+    runner.add("searchedPgnPipeline", _searchedPgnPipeline, true);
+    runner.add("pipelineErrors", _pipelineErrors, true);
+    runner.add("analysisSession", _analysisSession, true);
+    runner.add("analyzedBoardCache", _analyzedBoardCache, true);
+    runner.add("asyncAnalysis", _asyncAnalysis, true);
+
+    return runner.run();
 }
@@ -1,7 +1,11 @@
 #pragma once
+
+#include <string>
+#include <vector>
+
 class Tests
 {
 public:
-    static void RunTests();
+    // runs every test case, see TestRunnerOptions for the arguments. Returns the number of failed cases
+    static size_t RunTests(const std::vector<std::string>& args);
 };
-
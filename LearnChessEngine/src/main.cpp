@@ -8,9 +8,91 @@
 #include "tt.h"
 #include "uci.h"
 
+#include "Benchmark.h"
 #include "Board.h"
+#include "GamePipeline.h"
+#include "SearchPool.h"
 #include "Tests.h"
 
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+    // "pgn <file|-> [depth]" annotates every ply of every game to std::cout, searching each one when a depth is given
+    int _annotatePgn(const std::vector<std::string>& args)
+    {
+        if (args.empty())
+        {
+            std::cerr << "usage: pgn <file|-> [depth]" << std::endl;
+            return 1;
+        }
+
+        std::ifstream file;
+        if (args[0] != "-")
+        {
+            file.open(args[0]);
+            if (!file)
+            {
+                std::cerr << "Could not open " << args[0] << std::endl;
+                return 1;
+            }
+        }
+
+        std::optional<AnalysisLimits> limits;
+        if (args.size() > 1)
+        {
+            limits.emplace();
+            try
+            {
+                size_t numParsed = 0;
+                limits->mDepth = std::stoi(args[1], &numParsed);
+                if (numParsed != args[1].size() || limits->mDepth < 1)
+                {
+                    throw std::invalid_argument(args[1]);
+                }
+            }
+            catch (const std::exception&)
+            {
+                std::cerr << "the depth has to be a positive number, not " << args[1] << "\nusage: pgn <file|-> [depth]" << std::endl;
+                return 1;
+            }
+        }
+
+        // the search prints its progress to std::cout, the annotations go around it
+        std::ostream annotations(std::cout.rdbuf());
+        std::cout.setstate(std::ios::failbit);
+
+        GamePipeline pipeline(limits);
+        try
+        {
+            pipeline.analyze(args[0] == "-" ? std::cin : file, [&annotations](const GameAnnotation& annotation)
+                {
+                    annotations << annotation;
+                });
+        }
+        catch (const std::exception& exception)
+        {
+            annotations.flush();
+            std::cout.clear();
+            std::cerr << "Could not annotate " << args[0] << ": " << exception.what() << std::endl;
+            return 1;
+        }
+        annotations.flush();
+        std::cout.clear();
+
+        const GameStatistics& statistics = pipeline.statistics();
+        std::cerr << statistics.mNumGames << " games, " << statistics.mNumPlies << " plies in "
+                  << statistics.mElapsedSeconds << " s: " << statistics.gamesPerSecond() << " games/s, "
+                  << statistics.pliesPerSecond() << " plies/s" << std::endl;
+        return 0;
+    }
+}
+
 int main(int argc, char* argv[]) {
     Stockfish::CommandLine::init(argc, argv);
     Stockfish::UCI::init(Stockfish::Options);
@@ -18,13 +100,36 @@ int main(int argc, char* argv[]) {
     Stockfish::PSQT::init();
     Stockfish::Bitboards::init();
     Stockfish::Position::init();
-    Stockfish::Bitbases::init();
     Stockfish::Endgames::init();
-    Stockfish::Threads.set(size_t(12));
-    Stockfish::Search::clear(); // After threads are up
 
-    Tests::RunTests();
+    // the search threads only start once something searches, "--threads N --hash MB --bind auto|on|off" say how
+    std::vector<std::string> args(argv + 1, argv + argc);
+    try
+    {
+        SearchPool::configure(SearchPoolOptions::parse(args));
+    }
+    catch (const std::exception& exception)
+    {
+        std::cerr << exception.what() << std::endl;
+        return 1;
+    }
+
+    // "bench [depth] [repeats] [threads]" measures the analysis layer and "pgn <file|-> [depth]" annotates games
+    // instead of running the tests
+    size_t numFailedTests = 0;
+    if (!args.empty() && args[0] == "bench")
+    {
+        numFailedTests = Benchmark::Run(std::vector<std::string>(args.begin() + 1, args.end()));
+    }
+    else if (!args.empty() && args[0] == "pgn")
+    {
+        numFailedTests = _annotatePgn(std::vector<std::string>(args.begin() + 1, args.end()));
+    }
+    else
+    {
+        numFailedTests = Tests::RunTests(args);
+    }
 
-    Stockfish::Threads.set(0);
-    return 0;
+    SearchPool::stop();
+    return numFailedTests ? 1 : 0;
 }
\ No newline at end of file
@@ -47,8 +47,11 @@ typedef bool(*fun3_t)(HANDLE, CONST GROUP_AFFINITY*, PGROUP_AFFINITY);
 #include <cstdlib>
 
 #if defined(__linux__) && !defined(__ANDROID__)
+#include <sched.h>
 #include <stdlib.h>
 #include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 #endif
 
 #if defined(__APPLE__) || defined(__ANDROID__) || defined(__OpenBSD__) || (defined(__GLIBCXX__) && !defined(_GLIBCXX_HAVE_ALIGNED_ALLOC) && !defined(_WIN32)) || defined(__e2k__)
@@ -487,9 +490,168 @@ void aligned_large_pages_free(void *mem) {
 
 namespace WinProcGroup {
 
-#ifndef _WIN32
+#if defined(__linux__) && !defined(__ANDROID__)
+
+namespace {
+
+  struct NumaNode {
+    int id;
+    vector<int> cpus;
+    int cores; // Physical cores, the first CPU of each set of SMT siblings
+  };
+
+  // Reads the first line of a sysfs file, empty if there is none
+  string read_line(const string& path) {
+
+    ifstream file(path);
+    string line;
+    getline(file, line);
+    return line;
+  }
+
+  // Expands a sysfs list like "0-3,8-11" into its numbers
+  vector<int> parse_list(const string& list) {
+
+    vector<int> ids;
+    stringstream ss(list);
+    string range;
+
+    while (getline(ss, range, ','))
+    {
+        if (range.empty() || range[0] < '0' || range[0] > '9')
+            continue;
+
+        const size_t dash = range.find('-');
+        const int first = stoi(range);
+        const int last = dash == string::npos ? first : stoi(range.substr(dash + 1));
+        for (int id = first; id <= last; ++id)
+            ids.push_back(id);
+    }
+
+    return ids;
+  }
+
+  // The NUMA nodes that have CPUs, read once
+  const vector<NumaNode>& numa_nodes() {
+
+    static const vector<NumaNode> nodes = [] {
+
+      vector<NumaNode> found;
+      for (int id : parse_list(read_line("/sys/devices/system/node/online")))
+      {
+          NumaNode node { id, parse_list(read_line("/sys/devices/system/node/node" + to_string(id) + "/cpulist")), 0 };
+
+          for (int cpu : node.cpus)
+          {
+              const vector<int> siblings = parse_list(read_line(
+                  "/sys/devices/system/cpu/cpu" + to_string(cpu) + "/topology/thread_siblings_list"));
+              node.cores += siblings.empty() || siblings[0] == cpu;
+          }
+
+          if (!node.cpus.empty())
+              found.push_back(node);
+      }
+
+      return found;
+    }();
+
+    return nodes;
+  }
+
+  // Index in numa_nodes() of the node for the thread with index idx, filled
+  // the same way as best_group() does on Windows. -1 with a single node.
+  int best_node_index(size_t idx) {
+
+    const vector<NumaNode>& nodes = numa_nodes();
+    if (nodes.size() < 2)
+        return -1;
+
+    vector<int> groups;
+    int threads = 0;
+    int cores = 0;
+
+    for (size_t n = 0; n < nodes.size(); ++n)
+    {
+        for (int i = 0; i < nodes[n].cores; ++i)
+            groups.push_back(int(n));
+
+        threads += int(nodes[n].cpus.size());
+        cores += nodes[n].cores;
+    }
+
+    for (int t = 0; t < threads - cores; ++t)
+        groups.push_back(t % int(nodes.size()));
+
+    return idx < groups.size() ? groups[idx] : -1;
+  }
+
+} // namespace
+
+
+/// bestNode() returns the NUMA node id for the thread with index idx
+
+int bestNode(size_t idx) {
+
+  const int n = best_node_index(idx);
+  return n == -1 ? -1 : numa_nodes()[n].id;
+}
+
+
+/// bindThisThread() binds the current thread to the CPUs of its node. The
+/// memory it touches first is then placed on that node by the kernel.
+
+void bindThisThread(size_t idx) {
+
+  const int n = best_node_index(idx);
+  if (n == -1)
+      return;
+
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  for (int cpu : numa_nodes()[n].cpus)
+      if (cpu < CPU_SETSIZE)
+          CPU_SET(cpu, &mask);
+
+  sched_setaffinity(0, sizeof(mask), &mask);
+}
+
+
+/// nodePages() asks the kernel for the node of up to 1024 pages spread evenly
+/// over the range, pages that were never touched are not counted.
+
+vector<size_t> nodePages(const void* mem, size_t size) {
+
+  constexpr size_t MaxSamples = 1024;
+  const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+  const size_t pages = size / pageSize;
+  const size_t samples = pages < MaxSamples ? pages : MaxSamples;
+
+  vector<void*> addresses(samples);
+  vector<int> status(samples);
+  for (size_t i = 0; i < samples; ++i)
+      addresses[i] = const_cast<char*>(static_cast<const char*>(mem)) + (i * pages / samples) * pageSize;
+
+  // With no target nodes move_pages() only reports where the pages are
+  vector<size_t> counts;
+  if (!samples || syscall(SYS_move_pages, 0, samples, addresses.data(), nullptr, status.data(), 0) != 0)
+      return counts;
+
+  for (int node : status)
+      if (node >= 0)
+      {
+          if (size_t(node) >= counts.size())
+              counts.resize(node + 1);
+          counts[node]++;
+      }
+
+  return counts;
+}
+
+#elif !defined(_WIN32)
 
 void bindThisThread(size_t) {}
+int bestNode(size_t) { return -1; }
+vector<size_t> nodePages(const void*, size_t) { return {}; }
 
 #else
 
@@ -587,6 +749,22 @@ void bindThisThread(size_t idx) {
       fun3(GetCurrentThread(), &affinity, nullptr);
 }
 
+
+/// bestNode() returns the group bindThisThread() uses for idx
+
+int bestNode(size_t idx) {
+
+  return best_group(idx);
+}
+
+
+/// nodePages() is not implemented on Windows
+
+vector<size_t> nodePages(const void*, size_t) {
+
+  return {};
+}
+
 #endif
 
 } // namespace WinProcGroup
@@ -183,9 +183,17 @@ inline uint64_t mul_hi64(uint64_t a, uint64_t b) {
 /// cores. To overcome this, some special platform specific API should be
 /// called to set group affinity for each thread. Original code from Texel by
 /// Peter Österlund.
+///
+/// On Linux the same is done for NUMA nodes, which are read from sysfs.
+/// bestNode() is the node (or Windows group) thread idx is bound to, -1 if
+/// it isn't. nodePages() samples on which nodes the pages of [mem, mem + size)
+/// are, as the number of pages found on each node id, and is empty where
+/// that can't be queried.
 
 namespace WinProcGroup {
   void bindThisThread(size_t idx);
+  int bestNode(size_t idx);
+  std::vector<size_t> nodePages(const void* mem, size_t size);
 }
 
 namespace CommandLine {
@@ -19,6 +19,7 @@
 #include <cassert>
 
 #include "movepick.h"
+#include "tt.h"
 
 namespace Stockfish {
 
@@ -46,6 +47,16 @@ namespace {
         }
   }
 
+  // pseudo_legal() of a move from the transposition table, counting those it rejects
+  bool tt_move_is_pseudo_legal(const Position& pos, Move ttm) {
+
+    const bool pseudoLegal = pos.pseudo_legal(ttm);
+    if (!pseudoLegal)
+        ThreadTTStats->inc(TTStats::REJECTED_MOVES);
+
+    return pseudoLegal;
+  }
+
 } // namespace
 
 
@@ -64,7 +75,7 @@ MovePicker::MovePicker(const Position& p, Move ttm, Depth d, const ButterflyHist
   assert(d > 0);
 
   stage = (pos.checkers() ? EVASION_TT : MAIN_TT) +
-          !(ttm && pos.pseudo_legal(ttm));
+          !(ttm && tt_move_is_pseudo_legal(pos, ttm));
 }
 
 /// MovePicker constructor for quiescence search
@@ -77,7 +88,7 @@ MovePicker::MovePicker(const Position& p, Move ttm, Depth d, const ButterflyHist
   stage = (pos.checkers() ? EVASION_TT : QSEARCH_TT) +
           !(   ttm
             && (pos.checkers() || depth > DEPTH_QS_RECAPTURES || to_sq(ttm) == recaptureSquare)
-            && pos.pseudo_legal(ttm));
+            && tt_move_is_pseudo_legal(pos, ttm));
 }
 
 /// MovePicker constructor for ProbCut: we generate captures with SEE greater
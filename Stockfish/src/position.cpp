@@ -50,6 +50,9 @@ const string PieceToChar(" PNBRQK  pnbrqk");
 
 constexpr Piece Pieces[] = { W_PAWN, W_KNIGHT, W_BISHOP, W_ROOK, W_QUEEN, W_KING,
                              B_PAWN, B_KNIGHT, B_BISHOP, B_ROOK, B_QUEEN, B_KING };
+
+// PieceToChar the other way round, NO_PIECE for characters that aren't a piece
+Piece CharToPiece[256];
 } // namespace
 
 
@@ -126,6 +129,9 @@ void Position::init() {
   Zobrist::side = rng.rand<Key>();
   Zobrist::noPawns = rng.rand<Key>();
 
+  for (Piece pc : Pieces)
+      CharToPiece[uint8_t(PieceToChar[pc])] = pc;
+
   // Prepare the cuckoo tables
   std::memset(cuckoo, 0, sizeof(cuckoo));
   std::memset(cuckooMove, 0, sizeof(cuckooMove));
@@ -289,6 +295,105 @@ Position& Position::set(const string& fenStr, bool isChess960, StateInfo* si, Th
 }
 
 
+/// Position::key_of() returns the key() of the position that set() would set up
+/// from the given FEN string, without setting it up. It only reads the fields
+/// that go into the key, which makes it cheap enough to look positions up by
+/// their FEN in tables keyed by position. Unlike set() it expects the fields
+/// to be separated by single spaces, as fen() writes them.
+
+Key Position::key_of(const string& fenStr) {
+
+  Key k = 0;
+  Bitboard byColor[COLOR_NB] = {}, rooks = 0, pawns = 0;
+  Square ksq[COLOR_NB] = { SQ_A1, SQ_A1 };
+  Square sq = SQ_A8;
+  Piece pc;
+  size_t i = 0;
+
+  // 1. Piece placement
+  for ( ; i < fenStr.size() && fenStr[i] != ' '; ++i)
+  {
+      char token = fenStr[i];
+
+      if (token >= '1' && token <= '8')
+          sq += (token - '0') * EAST;
+
+      else if (token == '/')
+          sq += 2 * SOUTH;
+
+      else if ((pc = CharToPiece[uint8_t(token)]) != NO_PIECE)
+      {
+          k ^= Zobrist::psq[pc][sq];
+          byColor[color_of(pc)] |= sq;
+          rooks |= type_of(pc) == ROOK ? square_bb(sq) : 0;
+          pawns |= type_of(pc) == PAWN ? square_bb(sq) : 0;
+          if (type_of(pc) == KING)
+              ksq[color_of(pc)] = sq;
+          ++sq;
+      }
+  }
+
+  // 2. Active color
+  Color us = (i + 1 < fenStr.size() && fenStr[i + 1] == 'w') ? WHITE : BLACK;
+  i += 3;
+
+  // 3. Castling availability, the rook squares are found the same way as in set()
+  CastlingRights cr = NO_CASTLING;
+  for ( ; i < fenStr.size() && fenStr[i] != ' '; ++i)
+  {
+      char token = fenStr[i];
+      Color c = islower(token) ? BLACK : WHITE;
+      Bitboard ourRooks = rooks & byColor[c] & rank_bb(relative_rank(c, RANK_1));
+      Square rsq;
+
+      token = char(toupper(token));
+
+      if (token == 'K' && ourRooks)
+          rsq = msb(ourRooks);
+
+      else if (token == 'Q' && ourRooks)
+          rsq = lsb(ourRooks);
+
+      else if (token >= 'A' && token <= 'H')
+          rsq = make_square(File(token - 'A'), relative_rank(c, RANK_1));
+
+      else
+          continue;
+
+      cr = CastlingRights(cr | (c & (ksq[c] < rsq ? KING_SIDE : QUEEN_SIDE)));
+  }
+
+  // 4. En passant square, counted under the same conditions as in set()
+  if (   i + 2 < fenStr.size()
+      && fenStr[i + 1] >= 'a' && fenStr[i + 1] <= 'h'
+      && fenStr[i + 2] == (us == WHITE ? '6' : '3'))
+  {
+      Square ep = make_square(File(fenStr[i + 1] - 'a'), Rank(fenStr[i + 2] - '1'));
+
+      if (   (pawn_attacks_bb(~us, ep) & pawns & byColor[us])
+          && (pawns & byColor[~us] & (ep + pawn_push(~us)))
+          && !((byColor[WHITE] | byColor[BLACK]) & (ep | (ep + pawn_push(us)))))
+          k ^= Zobrist::enpassant[file_of(ep)];
+  }
+
+  // 5. Halfmove clock, which key() mixes in from 14 plies on
+  i += 2;
+  while (i < fenStr.size() && fenStr[i] != ' ')
+      ++i;
+
+  int rule50 = 0;
+  for (++i; i < fenStr.size() && fenStr[i] >= '0' && fenStr[i] <= '9'; ++i)
+      rule50 = 10 * rule50 + (fenStr[i] - '0');
+
+  if (us == BLACK)
+      k ^= Zobrist::side;
+
+  k ^= Zobrist::castling[cr];
+
+  return rule50 < 14 ? k : k ^ make_key((rule50 - 14) / 8);
+}
+
+
 /// Position::set_castling_right() is a helper function used to set castling
 /// rights given the corresponding color and the rook starting square.
 
@@ -685,7 +790,10 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
   assert(is_ok(m));
   assert(&newSt != st);
 
-  thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+  // Positions that are only queried, never searched, may have no thread
+  if (thisThread)
+      thisThread->nodes.fetch_add(1, std::memory_order_relaxed);
+
   Key k = st->key ^ Zobrist::side;
 
   // Copy some fields of the old state to our new StateInfo object except the
@@ -771,7 +879,8 @@ void Position::do_move(Move m, StateInfo& newSt, bool givesCheck) {
       // Update material hash key and prefetch access to materialTable
       k ^= Zobrist::psq[captured][capsq];
       st->materialKey ^= Zobrist::psq[captured][pieceCount[captured]];
-      prefetch(thisThread->materialTable[st->materialKey]);
+      if (thisThread)
+          prefetch(thisThread->materialTable[st->materialKey]);
 
       // Reset rule 50 counter
       st->rule50 = 0;
@@ -89,6 +89,7 @@ public:
   Position& set(const std::string& fenStr, bool isChess960, StateInfo* si, Thread* th);
   Position& set(const std::string& code, Color c, StateInfo* si);
   std::string fen() const;
+  static Key key_of(const std::string& fenStr);
 
   // Position representation
   Bitboard pieces(PieceType pt) const;
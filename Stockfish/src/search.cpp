@@ -19,6 +19,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <chrono>
 #include <cstring>   // For std::memset
 #include <iostream>
 #include <sstream>
@@ -91,6 +92,11 @@ namespace {
     return VALUE_DRAW + Value(2 * (thisThread->nodes & 1) - 1);
   }
 
+  // Number of PV lines of the current search, from its limits or the UCI option
+  size_t multi_pv() {
+    return Limits.multiPV ? Limits.multiPV : size_t(Options["MultiPV"]);
+  }
+
   // Skill structure is used to implement strength limit
   struct Skill {
     explicit Skill(int l) : level(l) {}
@@ -187,6 +193,24 @@ void MainThread::search() {
 
   Eval::NNUE::verify();
 
+  if (Threads.independent)
+  {
+      Threads.start_searching(); // start non-main threads
+      Thread::search();          // main thread searches its own position
+
+      // Nobody else checks the time, so keep doing it until all helpers are done
+      while (!Threads.stop && Threads.helpersSearching)
+      {
+          std::this_thread::sleep_for(std::chrono::milliseconds(1));
+          callsCnt = 0;
+          check_time();
+      }
+
+      Threads.stop = true;
+      Threads.wait_for_search_finished();
+      return;
+  }
+
   if (rootMoves.empty())
   {
       rootMoves.emplace_back(MOVE_NONE);
@@ -223,7 +247,7 @@ void MainThread::search() {
 
   Thread* bestThread = this;
 
-  if (   int(Options["MultiPV"]) == 1
+  if (   multi_pv() == 1
       && !Limits.depth
       && !(Skill(Options["Skill Level"]).enabled() || int(Options["UCI_LimitStrength"]))
       && rootMoves[0].pv[0] != MOVE_NONE)
@@ -250,6 +274,10 @@ void MainThread::search() {
 
 void Thread::search() {
 
+  // Can only happen when searching independent positions
+  if (rootMoves.empty())
+      return;
+
   // To allow access to (ss-7) up to (ss+2), the stack must be oversized.
   // The former is needed to allow update_continuation_histories(ss-1, ...),
   // which accesses its argument at ss-6, also near the root.
@@ -289,7 +317,7 @@ void Thread::search() {
   std::copy(&lowPlyHistory[2][0], &lowPlyHistory.back().back() + 1, &lowPlyHistory[0][0]);
   std::fill(&lowPlyHistory[MAX_LPH - 2][0], &lowPlyHistory.back().back() + 1, 0);
 
-  size_t multiPV = size_t(Options["MultiPV"]);
+  size_t multiPV = multi_pv();
 
   // Pick integer skill levels, but non-deterministically round up or down
   // such that the average integer skill corresponds to the input floating point one.
@@ -319,7 +347,7 @@ void Thread::search() {
   // Iterative deepening loop until requested to stop or the target depth is reached
   while (   ++rootDepth < MAX_PLY
          && !Threads.stop
-         && !(Limits.depth && mainThread && rootDepth > Limits.depth))
+         && !(Limits.depth && (mainThread || Threads.independent) && rootDepth > Limits.depth))
   {
       // Age out PV variability metric
       if (mainThread)
@@ -431,6 +459,9 @@ void Thread::search() {
       if (!Threads.stop)
           completedDepth = rootDepth;
 
+      if (mainThread && !Threads.stop && Limits.onIteration)
+          Limits.onIteration(rootMoves, completedDepth);
+
       if (rootMoves[0].pv[0] != lastBestMove) {
          lastBestMove = rootMoves[0].pv[0];
          lastBestMoveDepth = rootDepth;
@@ -636,6 +667,9 @@ namespace {
     thisThread->ttHitAverage =   (TtHitAverageWindow - 1) * thisThread->ttHitAverage / TtHitAverageWindow
                                 + TtHitAverageResolution * ss->ttHit;
 
+    if (ss->ttHit && tte->depth() >= depth)
+        thisThread->ttStats.inc(TTStats::USABLE_HITS);
+
     // At non-PV nodes we check for an early TT cutoff
     if (  !PvNode
         && ss->ttHit
@@ -1404,6 +1438,9 @@ moves_loop: // When in check, search starts from here
     ttMove = ss->ttHit ? tte->move() : MOVE_NONE;
     pvHit = ss->ttHit && tte->is_pv();
 
+    if (ss->ttHit && tte->depth() >= ttDepth)
+        thisThread->ttStats.inc(TTStats::USABLE_HITS);
+
     if (  !PvNode
         && ss->ttHit
         && tte->depth() >= ttDepth
@@ -1807,7 +1844,7 @@ string UCI::pv(const Position& pos, Depth depth, Value alpha, Value beta) {
   TimePoint elapsed = Time.elapsed() + 1;
   const RootMoves& rootMoves = pos.this_thread()->rootMoves;
   size_t pvIdx = pos.this_thread()->pvIdx;
-  size_t multiPV = std::min((size_t)Options["MultiPV"], rootMoves.size());
+  size_t multiPV = std::min(multi_pv(), rootMoves.size());
   uint64_t nodesSearched = Threads.nodes_searched();
   uint64_t tbHits = Threads.tb_hits() + (TB::RootInTB ? rootMoves.size() : 0);
 
@@ -19,6 +19,7 @@
 #ifndef SEARCH_H_INCLUDED
 #define SEARCH_H_INCLUDED
 
+#include <functional>
 #include <vector>
 
 #include "misc.h"
@@ -90,6 +91,7 @@ struct LimitsType {
     time[WHITE] = time[BLACK] = inc[WHITE] = inc[BLACK] = npmsec = movetime = TimePoint(0);
     movestogo = depth = mate = perft = infinite = 0;
     nodes = 0;
+    multiPV = 0;
   }
 
   bool use_time_management() const {
@@ -100,6 +102,20 @@ struct LimitsType {
   TimePoint time[COLOR_NB], inc[COLOR_NB], npmsec, movetime, startTime;
   int movestogo, depth, mate, perft, infinite;
   int64_t nodes;
+
+  // Number of PV lines to search, instead of the MultiPV option when not 0.
+  // Lets embedding applications set it per search without touching the option.
+  size_t multiPV;
+
+  // Called by the main thread after each completed iteration, with the root
+  // moves sorted as far as MultiPV goes. Meant for embedding applications.
+  std::function<void(const RootMoves&, Depth)> onIteration;
+
+  // The line the search is expected to find, e.g. what is left of the previous
+  // search's PV once its first move was played. Its first move is searched
+  // first, so the first iteration starts down the part of the previous tree
+  // that is still in the TT. Meant for embedding applications.
+  std::vector<Move> expectedLine;
 };
 
 extern LimitsType Limits;
@@ -102,10 +102,12 @@ void Thread::idle_loop() {
   // the choice, eventually we are one of many one-threaded processes running on
   // some Windows NUMA hardware, for instance in fishtest. To make it simple,
   // just check if running threads are below a threshold, in this case all this
-  // NUMA machinery is not needed.
-  if (Options["Threads"] > 8)
+  // NUMA machinery is not needed. The "Bind Threads" option can force either way.
+  if (Threads.binds_threads())
       WinProcGroup::bindThisThread(idx);
 
+  ThreadTTStats = &ttStats;
+
   while (true)
   {
       std::unique_lock<std::mutex> lk(mutex);
@@ -119,6 +121,9 @@ void Thread::idle_loop() {
       lk.unlock();
 
       search();
+
+      if (Threads.independent && this != Threads.main())
+          --Threads.helpersSearching;
   }
 }
 
@@ -166,6 +171,17 @@ void ThreadPool::clear() {
 }
 
 
+/// ThreadPool::binds_threads() tells whether the search threads, and the
+/// threads clearing the hash, are bound to a NUMA node (a processor group on
+/// Windows) by their index.
+
+bool ThreadPool::binds_threads() const {
+
+  return   Options["Bind Threads"] == "on"
+        || (Options["Bind Threads"] == "auto" && Options["Threads"] > 8);
+}
+
+
 /// ThreadPool::start_thinking() wakes up main thread waiting in idle_loop() and
 /// returns immediately. Main thread will wake up other threads and start the search.
 
@@ -176,6 +192,7 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
 
   main()->stopOnPonderhit = stop = false;
   increaseDepth = true;
+  independent = false;
   main()->ponder = ponderMode;
   Search::Limits = limits;
   Search::RootMoves rootMoves;
@@ -188,6 +205,15 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   if (!rootMoves.empty())
       Tablebases::rank_root_moves(pos, rootMoves);
 
+  // Move the expected move to the front, where it is the root TT move of the
+  // first iteration, unless the tablebases ranked it lower
+  if (!limits.expectedLine.empty())
+  {
+      auto expected = std::find(rootMoves.begin(), rootMoves.end(), limits.expectedLine[0]);
+      if (expected != rootMoves.end() && expected->tbRank == rootMoves[0].tbRank)
+          std::rotate(rootMoves.begin(), expected, expected + 1);
+  }
+
   // After ownership transfer 'states' becomes empty, so if we stop the search
   // and call 'go' again without setting a new position states.get() == NULL.
   assert(states.get() || setupStates.get());
@@ -203,6 +229,7 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   for (Thread* th : *this)
   {
       th->nodes = th->tbHits = th->nmpMinPly = th->bestMoveChanges = 0;
+      th->ttStats.clear();
       th->rootDepth = th->completedDepth = 0;
       th->rootMoves = rootMoves;
       th->rootPos.set(pos.fen(), pos.is_chess960(), &th->rootState, th);
@@ -212,6 +239,52 @@ void ThreadPool::start_thinking(Position& pos, StateListPtr& states,
   main()->start_searching();
 }
 
+
+/// ThreadPool::start_thinking() with a list of fens starts one single-threaded
+/// search per position instead of a Lazy SMP search of a single position, for
+/// bulk analysis of many positions. Every thread searches the fen with its
+/// index (threads without one stay idle) using its own history tables, while
+/// the TT is shared. Depth and movetime limits apply to each search, a nodes
+/// limit to all of them together.
+
+void ThreadPool::start_thinking(const std::vector<std::string>& fens,
+                                const Search::LimitsType& limits) {
+
+  assert(!fens.empty() && fens.size() <= size());
+
+  main()->wait_for_search_finished();
+
+  main()->stopOnPonderhit = stop = false;
+  increaseDepth = true;
+  independent = true;
+  helpersSearching = size() - 1;
+  main()->ponder = false;
+  Search::Limits = limits;
+
+  for (size_t idx = 0; idx < size(); ++idx)
+  {
+      Thread* th = (*this)[idx];
+      th->nodes = th->tbHits = th->nmpMinPly = th->bestMoveChanges = 0;
+      th->ttStats.clear();
+      th->rootDepth = th->completedDepth = 0;
+      th->rootMoves.clear();
+
+      if (idx >= fens.size())
+          continue;
+
+      // Root positions come straight from a fen, so there is no history to copy
+      th->rootPos.set(fens[idx], false, &th->rootState, th);
+
+      for (const auto& m : MoveList<LEGAL>(th->rootPos))
+          th->rootMoves.emplace_back(m);
+
+      if (!th->rootMoves.empty())
+          Tablebases::rank_root_moves(th->rootPos, th->rootMoves);
+  }
+
+  main()->start_searching();
+}
+
 Thread* ThreadPool::get_best_thread() const {
 
     Thread* bestThread = front();
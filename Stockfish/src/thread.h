@@ -31,6 +31,7 @@
 #include "position.h"
 #include "search.h"
 #include "thread_win32_osx.h"
+#include "tt.h"
 
 namespace Stockfish {
 
@@ -64,6 +65,7 @@ public:
   int selDepth, nmpMinPly;
   Color nmpColor;
   std::atomic<uint64_t> nodes, tbHits, bestMoveChanges;
+  TTStats ttStats;
 
   Position rootPos;
   StateInfo rootState;
@@ -103,6 +105,7 @@ struct MainThread : public Thread {
 struct ThreadPool : public std::vector<Thread*> {
 
   void start_thinking(Position&, StateListPtr&, const Search::LimitsType&, bool = false);
+  void start_thinking(const std::vector<std::string>& fens, const Search::LimitsType&);
   void clear();
   void set(size_t);
 
@@ -112,8 +115,11 @@ struct ThreadPool : public std::vector<Thread*> {
   Thread* get_best_thread() const;
   void start_searching();
   void wait_for_search_finished() const;
+  bool binds_threads() const;
 
   std::atomic_bool stop, increaseDepth;
+  bool independent; // Each thread searches its own root position
+  std::atomic<size_t> helpersSearching;
 
 private:
   StateListPtr setupStates;
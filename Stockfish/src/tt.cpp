@@ -16,9 +16,28 @@
   along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+#include <cstdio>    // For std::remove, std::rename
 #include <cstring>   // For std::memset
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#else
+#define WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#  define NOMINMAX // Disable macros min() and max()
+#endif
+#include <windows.h>
+#endif
 
 #include "bitboard.h"
 #include "misc.h"
@@ -30,9 +49,65 @@ namespace Stockfish {
 
 TranspositionTable TT; // Our global transposition table
 
+namespace { TTStats UnreportedStats; }
+
+thread_local TTStats* ThreadTTStats = &UnreportedStats;
+
+namespace {
+
+  // Header of a saved table, at the start of the file's first page
+  struct FileHeader {
+    char     magic[8];
+    uint32_t version;
+    uint32_t clusterSize;
+    uint32_t entrySize;   // Tells the entries of TT_LOCKLESS builds apart
+    uint64_t clusterCount;
+    uint8_t  generation8;
+  };
+
+  constexpr char FileMagic[8] = "SFHASH";
+
+  // floor(a * b / c) for a < c, with rem set to the remainder. Exact for any
+  // sizes, by a bitwise division of the 128 bit product, which is fine as it
+  // is only done once per slice.
+  uint64_t mul_div(uint64_t a, uint64_t b, uint64_t c, uint64_t& rem) {
+
+    const uint64_t hi = mul_hi64(a, b), lo = a * b;
+    uint64_t q = 0;
+    rem = 0;
+
+    for (int bit = 127; bit >= 0; --bit)
+    {
+        const bool carry = rem >> 63;
+        rem = rem << 1 | ((bit >= 64 ? hi >> (bit - 64) : lo >> bit) & 1);
+        q <<= 1;
+        if (carry || rem >= c)
+        {
+            rem -= c;
+            q |= 1;
+        }
+    }
+
+    return q;
+  }
+
+  void unmap_file(void* mapping, size_t size) {
+
+#ifdef _WIN32
+    (void)size;
+    UnmapViewOfFile(mapping);
+#else
+    munmap(mapping, size);
+#endif
+  }
+
+} // namespace
+
 /// TTEntry::save() populates the TTEntry with a new node's data, possibly
 /// overwriting an old position. Update is not atomic and can be racy.
 
+#ifndef TT_LOCKLESS
+
 void TTEntry::save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev) {
 
   // Preserve any existing move for the same position
@@ -47,35 +122,86 @@ void TTEntry::save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev)
       assert(d > DEPTH_OFFSET);
       assert(d < 256 + DEPTH_OFFSET);
 
+      ThreadTTStats->inc(!depth8 ? TTStats::SAVES_EMPTY : (uint16_t)k == key16 ? TTStats::SAVES_SAME
+                                                                              : TTStats::SAVES_REPLACED);
+
       key16     = (uint16_t)k;
       depth8    = (uint8_t)(d - DEPTH_OFFSET);
       genBound8 = (uint8_t)(TT.generation8 | uint8_t(pv) << 2 | b);
       value16   = (int16_t)v;
       eval16    = (int16_t)ev;
   }
+  else
+      ThreadTTStats->inc(TTStats::SAVES_KEPT);
 }
 
+#else
+
+void TTEntry::save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev) {
+
+  // Work on a copy, the entry is only written back as a whole
+  const uint64_t old = data;
+  const bool samePosition = (key64 ^ old) == k;
+
+  // Preserve any existing move for the same position
+  const uint16_t move16 = m || !samePosition ? (uint16_t)m : uint16_t(old);
+
+  // Overwrite less valuable entries (cheapest checks first)
+  if (b == BOUND_EXACT
+      || !samePosition
+      || d - DEPTH_OFFSET > uint8_t(old >> 48) - 4)
+  {
+      assert(d > DEPTH_OFFSET);
+      assert(d < 256 + DEPTH_OFFSET);
+
+      ThreadTTStats->inc(!uint8_t(old >> 48) ? TTStats::SAVES_EMPTY : samePosition ? TTStats::SAVES_SAME
+                                                                                    : TTStats::SAVES_REPLACED);
+      write(k,   uint64_t(move16)
+               | uint64_t(uint16_t(v))  << 16
+               | uint64_t(uint16_t(ev)) << 32
+               | uint64_t(uint8_t(d - DEPTH_OFFSET)) << 48
+               | uint64_t(uint8_t(TT.generation8 | uint8_t(pv) << 2 | b)) << 56);
+  }
+  else
+  {
+      ThreadTTStats->inc(TTStats::SAVES_KEPT);
+      if (move16 != uint16_t(old))
+          write(k, (old & ~uint64_t(0xFFFF)) | move16);
+  }
+}
+
+#endif
+
 
 /// TranspositionTable::resize() sets the size of the transposition table,
 /// measured in megabytes. Transposition table consists of a power of 2 number
 /// of clusters and each cluster consists of ClusterSize number of TTEntry.
+/// With keepEntries the entries of the current table are moved to the new one
+/// (see rehash()) instead of being cleared, which needs both tables in memory
+/// until it is done.
 
-void TranspositionTable::resize(size_t mbSize) {
+void TranspositionTable::resize(size_t mbSize, bool keepEntries) {
 
   Threads.main()->wait_for_search_finished();
 
-  aligned_large_pages_free(table);
-
-  clusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
+  const size_t newClusterCount = mbSize * 1024 * 1024 / sizeof(Cluster);
 
-  table = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
-  if (!table)
+  if (keepEntries && table)
   {
-      std::cerr << "Failed to allocate " << mbSize
-                << "MB for transposition table." << std::endl;
-      exit(EXIT_FAILURE);
+      Cluster* newTable = allocate(newClusterCount);
+      rehash(newTable, newClusterCount);
+
+      free_table();
+      table = newTable;
+      clusterCount = newClusterCount;
+      return;
   }
 
+  free_table();
+
+  clusterCount = newClusterCount;
+  table = allocate(clusterCount);
+
   clear();
 }
 
@@ -85,23 +211,120 @@ void TranspositionTable::resize(size_t mbSize) {
 
 void TranspositionTable::clear() {
 
+  // A table loaded from a file goes back to memory of its own
+  if (mappedFile)
+  {
+      free_table();
+      table = allocate(clusterCount);
+  }
+
+  for_each_slice(clusterCount, [this](size_t start, size_t len) {
+      std::memset(&table[start], 0, len * sizeof(Cluster));
+  });
+}
+
+
+/// TranspositionTable::rehash() fills newTable with the entries of the current
+/// table. A new cluster covers a range of keys, and so of old clusters, and
+/// takes the most valuable entries of those: the deepest and most recent, by
+/// the measure probe() replaces with. Only the low 16 bits of a key are kept,
+/// so when growing, an entry can't be told apart between the new clusters of
+/// its old one and is copied to all of them, where the one it belongs to finds
+/// it. With TT_LOCKLESS the full key is kept and each entry only goes where
+/// it belongs.
+
+void TranspositionTable::rehash(Cluster* newTable, size_t newClusterCount) const {
+
+  // New cluster j takes the old clusters from first = j * clusterCount / newClusterCount
+  // on, which is stepped along with its remainder from the start of each slice.
+  const uint64_t step    = clusterCount / newClusterCount;
+  const uint64_t stepRem = clusterCount % newClusterCount;
+
+  for_each_slice(newClusterCount, [&](size_t start, size_t len) {
+
+      uint64_t rem;
+      uint64_t first = mul_div(start, clusterCount, newClusterCount, rem);
+
+      for (size_t j = start; j < start + len; ++j)
+      {
+          uint64_t next = first + step, nextRem = rem + stepRem;
+          if (nextRem >= newClusterCount)
+          {
+              nextRem -= newClusterCount;
+              ++next;
+          }
+
+          // The last old cluster is next - 1 if cluster j + 1 starts exactly there
+          const uint64_t last = nextRem ? next : next - 1;
+
+          TTEntry best[ClusterSize];
+          int value[ClusterSize];
+          int count = 0;
+
+          for (uint64_t i = first; i <= last; ++i)
+              for (const TTEntry& tte : table[i].entry)
+              {
+#ifndef TT_LOCKLESS
+                  if (!tte.depth8)
+                      continue;
+
+                  const int v = tte.depth8 - ((GENERATION_CYCLE + generation8 - tte.genBound8) & GENERATION_MASK);
+#else
+                  if (!tte.depth8() || mul_hi64(tte.key64 ^ tte.data, newClusterCount) != j)
+                      continue;
+
+                  const int v = tte.depth8() - ((GENERATION_CYCLE + generation8 - tte.genBound8()) & GENERATION_MASK);
+#endif
+
+                  // Keep the ClusterSize best, in decreasing order
+                  if (count == ClusterSize && v <= value[ClusterSize - 1])
+                      continue;
+
+                  int k = count < ClusterSize ? count++ : ClusterSize - 1;
+                  for (; k > 0 && value[k - 1] < v; --k)
+                  {
+                      best[k]  = best[k - 1];
+                      value[k] = value[k - 1];
+                  }
+                  best[k]  = tte;
+                  value[k] = v;
+              }
+
+          std::memset(&newTable[j], 0, sizeof(Cluster));
+          for (int k = 0; k < count; ++k)
+              newTable[j].entry[k] = best[k];
+
+          first = next;
+          rem   = nextRem;
+      }
+  });
+}
+
+
+/// TranspositionTable::for_each_slice() splits [0, count) in one slice per
+/// search thread and calls fn(start, len) for each, in parallel. The threads
+/// are bound like the search threads with the same index, so on systems with
+/// a first-touch policy the memory they write first lands on their node.
+
+void TranspositionTable::for_each_slice(size_t count, const std::function<void(size_t, size_t)>& fn) const {
+
   std::vector<std::thread> threads;
 
   for (size_t idx = 0; idx < Options["Threads"]; ++idx)
   {
-      threads.emplace_back([this, idx]() {
+      threads.emplace_back([&fn, count, idx]() {
 
           // Thread binding gives faster search on systems with a first-touch policy
-          if (Options["Threads"] > 8)
+          if (Threads.binds_threads())
               WinProcGroup::bindThisThread(idx);
 
-          // Each thread will zero its part of the hash table
-          const size_t stride = size_t(clusterCount / Options["Threads"]),
+          // Each thread will handle its part of the range
+          const size_t stride = size_t(count / Options["Threads"]),
                        start  = size_t(stride * idx),
                        len    = idx != Options["Threads"] - 1 ?
-                                stride : clusterCount - start;
+                                stride : count - start;
 
-          std::memset(&table[start], 0, len * sizeof(Cluster));
+          fn(start, len);
       });
   }
 
@@ -110,6 +333,183 @@ void TranspositionTable::clear() {
 }
 
 
+/// TranspositionTable::allocate() returns memory for count clusters, and
+/// exits if there isn't enough.
+
+TranspositionTable::Cluster* TranspositionTable::allocate(size_t count) {
+
+  Cluster* mem = static_cast<Cluster*>(aligned_large_pages_alloc(count * sizeof(Cluster)));
+  if (!mem)
+  {
+      std::cerr << "Failed to allocate " << count * sizeof(Cluster) / (1024 * 1024)
+                << "MB for transposition table." << std::endl;
+      exit(EXIT_FAILURE);
+  }
+
+  return mem;
+}
+
+
+/// TranspositionTable::save() writes the table to a file, after a header with
+/// its size and generation. The file is written next to path and renamed over
+/// it once complete, so a table loaded from path stays valid while it is
+/// replaced. Returns false if the file could not be written.
+
+bool TranspositionTable::save(const std::string& path) {
+
+  if (!table)
+      return false;
+
+  if (Threads.size())
+      Threads.main()->wait_for_search_finished();
+
+  FileHeader header = {};
+  std::memcpy(header.magic, FileMagic, sizeof(FileMagic));
+  header.version      = FILE_VERSION;
+  header.clusterSize  = sizeof(Cluster);
+  header.entrySize    = sizeof(TTEntry);
+  header.clusterCount = clusterCount;
+  header.generation8  = generation8;
+
+  std::vector<char> headerPage(FILE_HEADER_SIZE, 0);
+  std::memcpy(headerPage.data(), &header, sizeof(header));
+
+  const std::string tmpPath = path + ".tmp";
+  std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+  file.write(headerPage.data(), FILE_HEADER_SIZE);
+  file.write(reinterpret_cast<const char*>(table), clusterCount * sizeof(Cluster));
+  file.close();
+
+  if (!file)
+  {
+      std::remove(tmpPath.c_str());
+      return false;
+  }
+
+#ifdef _WIN32
+  // Windows does not replace a file that is still mapped, so a loaded table
+  // is moved to memory of its own first. Saving has read all of it anyway.
+  if (mappedFile)
+  {
+      Cluster* mem = static_cast<Cluster*>(aligned_large_pages_alloc(clusterCount * sizeof(Cluster)));
+      if (!mem)
+      {
+          std::remove(tmpPath.c_str());
+          return false;
+      }
+
+      std::memcpy(mem, table, clusterCount * sizeof(Cluster));
+      free_table();
+      table = mem;
+  }
+
+  const bool replaced = MoveFileExA(tmpPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  const bool replaced = std::rename(tmpPath.c_str(), path.c_str()) == 0;
+#endif
+
+  if (!replaced)
+      std::remove(tmpPath.c_str());
+
+  return replaced;
+}
+
+
+/// TranspositionTable::load() replaces the table with one saved by save(). The
+/// file is mapped copy-on-write instead of read, so loading is immediate and
+/// each page is only read from disk when a probe first touches it. Returns
+/// false, keeping the current table, if the file is missing, damaged or saved
+/// with another size than the current one.
+
+bool TranspositionTable::load(const std::string& path) {
+
+  if (!table)
+      return false;
+
+  if (Threads.size())
+      Threads.main()->wait_for_search_finished();
+
+  const size_t fileSize = FILE_HEADER_SIZE + clusterCount * sizeof(Cluster);
+  void* mapping = nullptr;
+
+#ifdef _WIN32
+  HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE)
+      return false;
+
+  LARGE_INTEGER size;
+  if (GetFileSizeEx(file, &size) && size_t(size.QuadPart) == fileSize)
+  {
+      HANDLE section = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+      if (section)
+      {
+          mapping = MapViewOfFile(section, FILE_MAP_COPY, 0, 0, 0);
+          CloseHandle(section); // The view keeps the mapping alive
+      }
+  }
+  CloseHandle(file);
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1)
+      return false;
+
+  struct stat st;
+  if (fstat(fd, &st) == 0 && size_t(st.st_size) == fileSize)
+  {
+      mapping = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+      if (mapping == MAP_FAILED)
+          mapping = nullptr;
+#if defined(MADV_RANDOM)
+      else
+          madvise(mapping, fileSize, MADV_RANDOM); // Probes never read the pages next to theirs
+#endif
+  }
+  close(fd); // The mapping keeps the file alive
+#endif
+
+  if (!mapping)
+      return false;
+
+  FileHeader header;
+  std::memcpy(&header, mapping, sizeof(header));
+  if (   std::memcmp(header.magic, FileMagic, sizeof(FileMagic))
+      || header.version != FILE_VERSION
+      || header.clusterSize != sizeof(Cluster)
+      || header.entrySize != sizeof(TTEntry)
+      || header.clusterCount != clusterCount)
+  {
+      unmap_file(mapping, fileSize);
+      return false;
+  }
+
+  free_table();
+  mappedFile  = mapping;
+  mappedSize  = fileSize;
+  table       = reinterpret_cast<Cluster*>(static_cast<char*>(mapping) + FILE_HEADER_SIZE);
+  generation8 = header.generation8;
+  return true;
+}
+
+
+/// TranspositionTable::free_table() releases the table, whether it was
+/// allocated or mapped from a file.
+
+void TranspositionTable::free_table() {
+
+  if (mappedFile)
+  {
+      unmap_file(mappedFile, mappedSize);
+      mappedFile = nullptr;
+      mappedSize = 0;
+  }
+  else
+      aligned_large_pages_free(table);
+
+  table = nullptr;
+}
+
+
 /// TranspositionTable::probe() looks up the current position in the transposition
 /// table. It returns true and a pointer to the TTEntry if the position is found.
 /// Otherwise, it returns false and a pointer to an empty or least valuable TTEntry
@@ -120,6 +520,10 @@ void TranspositionTable::clear() {
 TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
 
   TTEntry* const tte = first_entry(key);
+
+  ThreadTTStats->inc(TTStats::PROBES);
+
+#ifndef TT_LOCKLESS
   const uint16_t key16 = (uint16_t)key;  // Use the low 16 bits as key inside the cluster
 
   for (int i = 0; i < ClusterSize; ++i)
@@ -127,8 +531,28 @@ TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
       {
           tte[i].genBound8 = uint8_t(generation8 | (tte[i].genBound8 & (GENERATION_DELTA - 1))); // Refresh
 
+          if (tte[i].depth8)
+              ThreadTTStats->inc(TTStats::HITS);
+
           return found = (bool)tte[i].depth8, &tte[i];
       }
+#else
+  for (int i = 0; i < ClusterSize; ++i)
+  {
+      const uint64_t data = tte[i].data; // Verify and refresh the same copy of the entry
+      if ((tte[i].key64 ^ data) == key || !uint8_t(data >> 48))
+      {
+          const uint8_t genBound8 = uint8_t(generation8 | (uint8_t(data >> 56) & (GENERATION_DELTA - 1)));
+          if (genBound8 != uint8_t(data >> 56))
+              tte[i].write(key, (data & ~(uint64_t(0xFF) << 56)) | uint64_t(genBound8) << 56); // Refresh
+
+          if (uint8_t(data >> 48))
+              ThreadTTStats->inc(TTStats::HITS);
+
+          return found = (bool)uint8_t(data >> 48), &tte[i];
+      }
+  }
+#endif
 
   // Find an entry to be replaced according to the replacement strategy
   TTEntry* replace = tte;
@@ -138,8 +562,13 @@ TTEntry* TranspositionTable::probe(const Key key, bool& found) const {
       // is needed to keep the unrelated lowest n bits from affecting
       // the result) to calculate the entry age correctly even after
       // generation8 overflows into the next cycle.
+#ifndef TT_LOCKLESS
       if (  replace->depth8 - ((GENERATION_CYCLE + generation8 - replace->genBound8) & GENERATION_MASK)
           >   tte[i].depth8 - ((GENERATION_CYCLE + generation8 -   tte[i].genBound8) & GENERATION_MASK))
+#else
+      if (  replace->depth8() - ((GENERATION_CYCLE + generation8 - replace->genBound8()) & GENERATION_MASK)
+          >   tte[i].depth8() - ((GENERATION_CYCLE + generation8 -   tte[i].genBound8()) & GENERATION_MASK))
+#endif
           replace = &tte[i];
 
   return found = false, replace;
@@ -154,9 +583,155 @@ int TranspositionTable::hashfull() const {
   int cnt = 0;
   for (int i = 0; i < 1000; ++i)
       for (int j = 0; j < ClusterSize; ++j)
+#ifndef TT_LOCKLESS
           cnt += table[i].entry[j].depth8 && (table[i].entry[j].genBound8 & GENERATION_MASK) == generation8;
+#else
+          cnt += table[i].entry[j].depth8() && (table[i].entry[j].genBound8() & GENERATION_MASK) == generation8;
+#endif
 
   return cnt / ClusterSize;
 }
 
+
+/// TranspositionTable::counters() sums the TTStats of the search threads.
+
+std::array<uint64_t, TTStats::COUNTER_NB> TranspositionTable::counters() const {
+
+  std::array<uint64_t, TTStats::COUNTER_NB> sum = {};
+  for (Thread* th : Threads)
+      for (int c = 0; c < TTStats::COUNTER_NB; ++c)
+          sum[c] += th->ttStats[TTStats::Counter(c)];
+
+  return sum;
+}
+
+
+/// TranspositionTable::stats_info() reports, as UCI info strings, the counters
+/// of the last search and how deep and how old the entries are, sampled from
+/// 1000 clusters spread over the whole table. It also estimates how often a
+/// probe for a position that isn't in the table hits another position that
+/// shares its 16 key bits, from how full the table is.
+
+std::string TranspositionTable::stats_info() const {
+
+  if (!table)
+      return "info string hash statistics are not available before the hash is allocated";
+
+  const std::array<uint64_t, TTStats::COUNTER_NB> c = counters();
+  const auto percent = [](uint64_t part, uint64_t whole) { return whole ? 100.0 * part / whole : 0.0; };
+
+  std::stringstream ss;
+  ss << std::fixed << std::setprecision(1);
+
+  ss << "info string hash probes " << c[TTStats::PROBES]
+     << " hits "     << percent(c[TTStats::HITS], c[TTStats::PROBES]) << "%"
+     << " usable "   << percent(c[TTStats::USABLE_HITS], c[TTStats::PROBES]) << "%"
+     << " rejected moves " << c[TTStats::REJECTED_MOVES] << "\n";
+
+  const uint64_t saves =  c[TTStats::SAVES_EMPTY] + c[TTStats::SAVES_SAME]
+                        + c[TTStats::SAVES_REPLACED] + c[TTStats::SAVES_KEPT];
+  ss << "info string hash saves " << saves
+     << " empty "    << percent(c[TTStats::SAVES_EMPTY], saves) << "%"
+     << " same "     << percent(c[TTStats::SAVES_SAME], saves) << "%"
+     << " replaced " << percent(c[TTStats::SAVES_REPLACED], saves) << "%"
+     << " kept "     << percent(c[TTStats::SAVES_KEPT], saves) << "%\n";
+
+  constexpr int BucketNb = 6;
+  const char* depthNames[BucketNb] = { "<=0", "1-4", "5-8", "9-12", "13-16", "17+" };
+  const char* ageNames[BucketNb]   = { "0", "1", "2", "3", "4-7", "8+" };
+  uint64_t depths[BucketNb] = {}, ages[BucketNb] = {}, entries = 0;
+
+  const size_t samples = std::min(clusterCount, size_t(1000));
+  for (size_t i = 0; i < samples; ++i)
+      for (const TTEntry& tte : table[i * clusterCount / samples].entry)
+      {
+#ifndef TT_LOCKLESS
+          const int depth8 = tte.depth8, genBound8 = tte.genBound8;
+#else
+          const int depth8 = tte.depth8(), genBound8 = tte.genBound8();
+#endif
+          if (!depth8)
+              continue;
+
+          const int depth = depth8 + DEPTH_OFFSET;
+          const int age = ((GENERATION_CYCLE + generation8 - genBound8) & GENERATION_MASK) / GENERATION_DELTA;
+
+          ++entries;
+          ++depths[depth <= 0 ? 0 : std::min((depth - 1) / 4 + 1, BucketNb - 1)];
+          ++ages[age < 4 ? age : age < 8 ? 4 : 5];
+      }
+
+  ss << "info string hash full " << percent(entries, samples * ClusterSize) << "% depth";
+  for (int i = 0; i < BucketNb; ++i)
+      ss << " " << depthNames[i] << " " << percent(depths[i], entries) << "%";
+
+  ss << "\ninfo string hash age in searches";
+  for (int i = 0; i < BucketNb; ++i)
+      ss << " " << ageNames[i] << " " << percent(ages[i], entries) << "%";
+
+#ifndef TT_LOCKLESS
+  // Any entry of the probed cluster with the same 16 bits is taken for a hit
+  ss << "\ninfo string hash false hits " << std::scientific << std::setprecision(2)
+     << double(entries) / samples / 65536 << " per probe of a new position";
+#else
+  ss << "\ninfo string hash false hits none, the full key is verified";
+#endif
+
+  return ss.str();
+}
+
+
+/// TranspositionTable::numa_info() reports on which NUMA nodes the pages of
+/// the table are, and from that estimates the share of probes that go to another
+/// node than the one of the thread probing. It is not measured: assuming keys
+/// spread evenly over the table, a thread on node n misses its node for all
+/// pages that aren't on n.
+
+std::string TranspositionTable::numa_info() const {
+
+  std::stringstream ss;
+  const std::vector<size_t> pages = table ? WinProcGroup::nodePages(table, clusterCount * sizeof(Cluster))
+                                          : std::vector<size_t>();
+  size_t total = 0;
+  for (size_t n : pages)
+      total += n;
+
+  if (!total)
+      return "info string NUMA placement of the hash is not available";
+
+  for (size_t node = 0; node < pages.size(); ++node)
+      if (pages[node])
+      {
+          ss << "info string node " << node << ": " << 100 * pages[node] / total << "% of the hash";
+          bool first = true;
+          for (size_t idx = 0; idx < Threads.size(); ++idx)
+              if (Threads.binds_threads() && WinProcGroup::bestNode(idx) == int(node))
+              {
+                  ss << (first ? ", threads " : " ") << idx;
+                  first = false;
+              }
+          ss << "\n";
+      }
+
+  double remote = 0;
+  size_t bound = 0;
+  for (size_t idx = 0; idx < Threads.size(); ++idx)
+  {
+      const int node = Threads.binds_threads() ? WinProcGroup::bestNode(idx) : -1;
+      if (node != -1)
+      {
+          remote += 1.0 - double(size_t(node) < pages.size() ? pages[node] : 0) / total;
+          ++bound;
+      }
+  }
+
+  if (bound)
+      ss << "info string estimated remote hash accesses: " << int(100 * remote / bound + 0.5)
+         << "% of the probes of " << bound << " bound threads (assuming probes are spread evenly over the hash)";
+  else
+      ss << "info string estimated remote hash accesses: unknown, no thread is bound to a node";
+
+  return ss.str();
+}
+
 } // namespace Stockfish
@@ -19,11 +19,18 @@
 #ifndef TT_H_INCLUDED
 #define TT_H_INCLUDED
 
+#include <array>
+#include <atomic>
+#include <functional>
+#include <string>
+
 #include "misc.h"
 #include "types.h"
 
 namespace Stockfish {
 
+#ifndef TT_LOCKLESS
+
 /// TTEntry struct is the 10 bytes transposition table entry, defined as below:
 ///
 /// key        16 bit
@@ -56,21 +63,107 @@ private:
   int16_t  eval16;
 };
 
+#else
+
+/// With TT_LOCKLESS, TTEntry is 16 bytes instead: the same data packed in one
+/// 64 bit word, next to the full 64 bit key XORed with that word. A probe only
+/// hits when the two XOR back to the position's key, so an entry torn by two
+/// threads writing it at once, or one of another position that shares the low
+/// 16 bits of the key, reads as a miss (Hyatt and Mann's lockless hashing).
+/// Built with lockless=yes in the Makefile, or /p:TTLockless=true for the
+/// Visual Studio projects. Everything that includes tt.h must agree on it.
+/// tests/lockless.sh compares the speed and false hits of the two layouts.
+///
+/// move       16 bit
+/// value      16 bit
+/// eval value 16 bit
+/// depth       8 bit
+/// generation  5 bit
+/// pv node     1 bit
+/// bound type  2 bit
+
+struct TTEntry {
+
+  Move  move()  const { return (Move )uint16_t(data); }
+  Value value() const { return (Value)int16_t(data >> 16); }
+  Value eval()  const { return (Value)int16_t(data >> 32); }
+  Depth depth() const { return (Depth)depth8() + DEPTH_OFFSET; }
+  bool is_pv()  const { return (bool)(genBound8() & 0x4); }
+  Bound bound() const { return (Bound)(genBound8() & 0x3); }
+  void save(Key k, Value v, bool pv, Bound b, Depth d, Move m, Value ev);
+
+private:
+  friend class TranspositionTable;
+
+  uint8_t depth8()    const { return uint8_t(data >> 48); }
+  uint8_t genBound8() const { return uint8_t(data >> 56); }
+  void write(Key k, uint64_t d) { data = d; key64 = k ^ d; }
+
+  uint64_t key64;
+  uint64_t data;
+};
+
+#endif
+
+
+/// TTStats counts what one thread does with the transposition table: probes
+/// and hits, hits deep enough to be used by search, moves that pseudo_legal()
+/// rejected (which come from another position with the same 16 key bits, or
+/// a torn entry), and what each save did to the entry. Only the owning thread
+/// writes them, so an increment is a relaxed load and store instead of a
+/// locked add, cheap enough to always be on. Other threads can read them while
+/// the search runs. Search threads reset them with each search.
+
+struct TTStats {
+
+  enum Counter {
+    PROBES, HITS, USABLE_HITS, REJECTED_MOVES,
+    SAVES_EMPTY,    // Wrote an empty entry
+    SAVES_SAME,     // Overwrote the same position
+    SAVES_REPLACED, // Replaced another position
+    SAVES_KEPT,     // Kept the entry, which is worth more than the new data
+    COUNTER_NB
+  };
+
+  void inc(Counter c) { counters[c].store(counters[c].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed); }
+  uint64_t operator[](Counter c) const { return counters[c].load(std::memory_order_relaxed); }
+  void clear() { for (auto& c : counters) c.store(0, std::memory_order_relaxed); }
+
+private:
+  std::atomic<uint64_t> counters[COUNTER_NB] = {};
+};
+
+/// The counters of the calling thread, search threads point it at their own.
+/// Other threads share counters that aren't reported.
+extern thread_local TTStats* ThreadTTStats;
+
 
 /// A TranspositionTable is an array of Cluster, of size clusterCount. Each
 /// cluster consists of ClusterSize number of TTEntry. Each non-empty TTEntry
 /// contains information on exactly one position. The size of a Cluster should
 /// divide the size of a cache line for best performance, as the cacheline is
 /// prefetched when possible.
+///
+/// The table can be saved to a file and loaded back later. A loaded table is
+/// mapped from the file copy-on-write, so its pages are only read when a
+/// probe first touches them and the file itself is never written to.
 
 class TranspositionTable {
 
+#ifndef TT_LOCKLESS
   static constexpr int ClusterSize = 3;
 
   struct Cluster {
     TTEntry entry[ClusterSize];
     char padding[2]; // Pad to 32 bytes
   };
+#else
+  static constexpr int ClusterSize = 2;
+
+  struct Cluster {
+    TTEntry entry[ClusterSize];
+  };
+#endif
 
   static_assert(sizeof(Cluster) == 32, "Unexpected Cluster size");
 
@@ -81,12 +174,17 @@ class TranspositionTable {
   static constexpr int      GENERATION_MASK  = (0xFF << GENERATION_BITS) & 0xFF; // mask to pull out generation number
 
 public:
- ~TranspositionTable() { aligned_large_pages_free(table); }
+ ~TranspositionTable() { free_table(); }
   void new_search() { generation8 += GENERATION_DELTA; } // Lower bits are used for other things
   TTEntry* probe(const Key key, bool& found) const;
   int hashfull() const;
-  void resize(size_t mbSize);
+  std::array<uint64_t, TTStats::COUNTER_NB> counters() const;
+  std::string stats_info() const;
+  std::string numa_info() const;
+  void resize(size_t mbSize, bool keepEntries = false);
   void clear();
+  bool save(const std::string& path);
+  bool load(const std::string& path);
 
   TTEntry* first_entry(const Key key) const {
     return &table[mul_hi64(key, clusterCount)].entry[0];
@@ -95,9 +193,20 @@ public:
 private:
   friend struct TTEntry;
 
+  // Files start with a header padded to a page, so the clusters that follow stay aligned
+  static constexpr size_t FILE_HEADER_SIZE = 4096;
+  static constexpr uint32_t FILE_VERSION   = 1;
+
+  static Cluster* allocate(size_t count);
+  void free_table();
+  void rehash(Cluster* newTable, size_t newClusterCount) const;
+  void for_each_slice(size_t count, const std::function<void(size_t, size_t)>& fn) const;
+
   size_t clusterCount;
   Cluster* table;
   uint8_t generation8; // Size must be not bigger than TTEntry::genBound8
+  void* mappedFile;    // Start of the file mapping when the table was loaded, table points into it
+  size_t mappedSize;
 };
 
 extern TranspositionTable TT;
@@ -277,6 +277,8 @@ void UCI::loop(int argc, char* argv[]) {
       else if (token == "d")        sync_cout << pos << sync_endl;
       else if (token == "eval")     trace_eval(pos);
       else if (token == "compiler") sync_cout << compiler_info() << sync_endl;
+      else if (token == "numa")     sync_cout << TT.numa_info() << sync_endl;
+      else if (token == "ttstats")  sync_cout << TT.stats_info() << sync_endl;
       else if (token == "export_net")
       {
           std::optional<std::string> filename;
@@ -285,6 +287,17 @@ void UCI::loop(int argc, char* argv[]) {
               filename = f;
           Eval::NNUE::save_eval(filename);
       }
+      else if (token == "savehash" || token == "loadhash")
+      {
+          std::string filename;
+          is >> skipws >> filename;
+          if (token == "savehash")
+              sync_cout << "info string " << (TT.save(filename) ? "Saved hash to " : "Failed to save hash to ")
+                        << filename << sync_endl;
+          else
+              sync_cout << "info string " << (TT.load(filename) ? "Loaded hash from " : "Failed to load hash from ")
+                        << filename << sync_endl;
+      }
       else if (!token.empty() && token[0] != '#')
           sync_cout << "Unknown command: " << cmd << sync_endl;
 
@@ -0,0 +1,32 @@
+#!/bin/bash
+# compare the default and the lockless (lockless=yes) transposition table layouts
+# on the same classical bench: speed, and the false hits ttstats estimates
+# usage, from the src directory: ../../tests/lockless.sh [ARCH] [depth] [hash MB]
+
+error()
+{
+  echo "lockless comparison failed on line $1"
+  exit 1
+}
+trap 'error ${LINENO}' ERR
+
+arch=${1:-x86-64-modern}
+depth=${2:-13}
+hash=${3:-16}
+
+echo "lockless comparison started: ARCH=$arch, depth $depth, $hash MB hash"
+
+for layout in no yes
+do
+  # the layout is a compile time switch, so every object is rebuilt
+  make -s objclean
+  make -s -j2 build ARCH=$arch lockless=$layout > /dev/null
+
+  echo "lockless=$layout"
+  printf "setoption name Use NNUE value false\nbench $hash 1 $depth default depth classical\nttstats\nquit\n" \
+    | ./stockfish 2>&1 | grep -E "Nodes searched|Nodes/second|false hits" | sed 's/^/  /'
+done
+
+make -s objclean
+
+echo "lockless comparison OK"